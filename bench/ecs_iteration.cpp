@@ -0,0 +1,115 @@
+// Per entity cost of walking two components, the pre archetype Entity/Group
+// layout against World views
+#include <array>
+#include <bitset>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "ecs/ecs.hpp"
+#include "bench.hpp"
+
+struct Position { int x; int y; };
+struct Velocity { int dx; int dy; };
+struct Sprite { int frame; };
+
+template <typename T>
+struct ecs::ComponentId : ecs::type_index<T, ecs::TypeList<Position, Velocity, Sprite>> { };
+
+// The old storage: every entity owns an array of shared_ptr components, each
+// one its own heap block, and components update themselves through virtuals
+// fetching their siblings from the entity
+namespace legacy {
+    constexpr std::size_t maxComponents = 32;
+
+    class Entity;
+
+    class Component {
+        protected:
+            Entity* m_entity = nullptr;
+        public:
+            virtual ~Component() { }
+            virtual void update() { }
+            void set_entity(Entity* e) { m_entity = e; }
+    };
+
+    inline std::size_t next_type_id() {
+        static std::size_t id = 0;
+        return id++;
+    }
+
+    template <typename T>
+    inline std::size_t type_id() {
+        static std::size_t id = next_type_id();
+        return id;
+    }
+
+    class Entity {
+        private:
+            std::array<std::shared_ptr<Component>, maxComponents> m_components;
+            std::bitset<maxComponents> m_mask;
+        public:
+            void update() { for (auto& c : m_components) if (c) c->update(); }
+
+            template <typename T, typename... TArgs>
+            std::shared_ptr<T> add_component(TArgs&&... args) {
+                auto c = std::make_shared<T>(std::forward<TArgs>(args)...);
+                c->set_entity(this);
+                m_components[type_id<T>()] = c;
+                m_mask.set(type_id<T>());
+                return c;
+            }
+
+            template <typename T>
+            std::shared_ptr<T> get_component() {
+                return std::static_pointer_cast<T>(m_components[type_id<T>()]);
+            }
+    };
+
+    struct PositionComponent : Component { Position value; };
+    struct SpriteComponent : Component { Sprite value; };
+    struct VelocityComponent : Component {
+        Velocity value;
+        void update() override {
+            auto& pos = m_entity->get_component<PositionComponent>()->value;
+            pos.x += value.dx;
+            pos.y += value.dy;
+        }
+    };
+};
+
+int main() {
+    logger::init("bench.log");
+    std::printf("%-10s %14s %14s\n", "entities", "legacy ns/ent", "world ns/ent");
+
+    for (int n : { 1000, 10000, 100000 }) {
+        std::vector<std::shared_ptr<legacy::Entity>> group;
+        ecs::World world;
+        for (int i = 0; i < n; ++i) {
+            auto e = std::make_shared<legacy::Entity>();
+            e->add_component<legacy::PositionComponent>()->value = Position { i, i };
+            e->add_component<legacy::VelocityComponent>()->value = Velocity { 1, -1 };
+            e->add_component<legacy::SpriteComponent>()->value = Sprite { i % 4 };
+            group.push_back(e);
+
+            world.spawn(Position { i, i }, Velocity { 1, -1 }, Sprite { i % 4 });
+        }
+
+        auto legacy = bench::measure(21, [&] {
+            for (auto& e : group) e->update();
+        });
+        auto archetype = bench::measure(21, [&] {
+            world.view<Position, Velocity>().each([](Position& p, Velocity& v) {
+                p.x += v.dx;
+                p.y += v.dy;
+            });
+        });
+
+        long check = 0;
+        world.view<Position>().each([&](Position& p) { check += p.x; });
+        bench::keep(check);
+
+        std::printf("%-10d %14.2f %14.2f\n", n, legacy / n, archetype / n);
+    }
+    return 0;
+}
@@ -0,0 +1,117 @@
+// Per lookup cost of fetching one component by entity, in random order:
+// the old shared_ptr get_component with its guarded static type id against
+// World::get and World::get_component
+#include <array>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "ecs/ecs.hpp"
+#include "random.hpp"
+#include "bench.hpp"
+
+struct Position { int x; int y; };
+struct Velocity { int dx; int dy; };
+struct Sprite { int frame; };
+
+template <typename T>
+struct ecs::ComponentId : ecs::type_index<T, ecs::TypeList<Position, Velocity, Sprite>> { };
+
+// The old lookup: a function-local static id (thread safe init guard on
+// every call) and a shared_ptr copy (two atomic ops) per get_component
+namespace legacy {
+    constexpr std::size_t maxComponents = 32;
+
+    struct Component {
+        virtual ~Component() { }
+    };
+
+    inline std::size_t next_type_id() {
+        static std::size_t id = 0;
+        return id++;
+    }
+
+    template <typename T>
+    inline std::size_t type_id() {
+        static std::size_t id = next_type_id();
+        return id;
+    }
+
+    class Entity {
+        private:
+            std::array<std::shared_ptr<Component>, maxComponents> m_components;
+        public:
+            template <typename T>
+            std::shared_ptr<T> add_component() {
+                auto c = std::make_shared<T>();
+                m_components[type_id<T>()] = c;
+                return c;
+            }
+
+            template <typename T>
+            std::shared_ptr<T> get_component() {
+                return std::static_pointer_cast<T>(m_components[type_id<T>()]);
+            }
+    };
+
+    struct PositionComponent : Component { Position value; };
+    struct VelocityComponent : Component { Velocity value; };
+};
+
+int main() {
+    logger::init("bench.log");
+    std::printf("%-10s %14s %14s %18s\n", "entities", "legacy ns/get", "get ns/get", "get_component ns");
+
+    rng::Rng rng { 8 };
+    for (int n : { 1000, 10000, 100000 }) {
+        std::vector<std::shared_ptr<legacy::Entity>> group;
+        std::vector<ecs::EntityId> ids;
+        ecs::World world;
+        for (int i = 0; i < n; ++i) {
+            auto e = std::make_shared<legacy::Entity>();
+            e->add_component<legacy::PositionComponent>()->value = Position { i, i };
+            e->add_component<legacy::VelocityComponent>()->value = Velocity { 1, -1 };
+            group.push_back(e);
+
+            ids.push_back(world.spawn(Position { i, i }, Velocity { 1, -1 }, Sprite { i % 4 }));
+        }
+
+        // Same random visiting order for all three
+        std::vector<int> order(n);
+        for (auto& i : order) {
+            i = rng.gen_int(0, n);
+        }
+
+        // Two lookups per visit, like a system reading one component and
+        // writing another
+        auto legacy = bench::measure(21, [&] {
+            for (int i : order) {
+                auto& e = *group[i];
+                auto v = e.get_component<legacy::VelocityComponent>();
+                auto p = e.get_component<legacy::PositionComponent>();
+                p->value.x += v->value.dx;
+            }
+        });
+        auto get = bench::measure(21, [&] {
+            for (int i : order) {
+                auto& v = world.get<Velocity>(ids[i]);
+                world.get<Position>(ids[i]).x += v.dx;
+            }
+        });
+        auto get_component = bench::measure(21, [&] {
+            for (int i : order) {
+                auto v = world.get_component<Velocity>(ids[i]);
+                auto p = world.get_component<Position>(ids[i]);
+                if (v && p) p->x += v->dx;
+            }
+        });
+
+        long check = 0;
+        world.view<Position>().each([&](Position& p) { check += p.x; });
+        bench::keep(check);
+        bench::keep(group[0]->get_component<legacy::PositionComponent>()->value.x);
+
+        std::printf("%-10d %14.2f %14.2f %18.2f\n", n, legacy / (2.0 * n), get / (2.0 * n), get_component / (2.0 * n));
+    }
+    return 0;
+}
@@ -0,0 +1,42 @@
+// FOV cost by radius, on an open map (worst case, everything is lit) and
+// a cave level
+#include <cstdio>
+
+#include "map/fov.hpp"
+#include "map/generators.hpp"
+#include "random.hpp"
+#include "bench.hpp"
+
+int main() {
+    logger::init("bench.log");
+    constexpr int size = 256;
+
+    Grid<TileType> open { size, size, TileType::Empty };
+    Grid<TileType> cave { size, size, TileType::Wall };
+    rng::Rng rng { 3 };
+    CaveGenerator {}.generate(cave, rng);
+
+    // First cave floor from the centre on, both maps use the same origin
+    Vector2D origin { size / 2, size / 2 };
+    while (cave.get(origin.x, origin.y) == TileType::Wall) {
+        origin.x += 1;
+    }
+
+    ShadowcastingFov shadowcasting;
+    RaycastingFov raycasting;
+    BitGrid visible { size, size };
+
+    std::printf("%-7s %16s %16s %16s %16s\n", "radius", "open shadow us", "open rays us", "cave shadow us", "cave rays us");
+    for (int radius : { 5, 10, 15, 20, 30, 40, 50, 60 }) {
+        auto time = [&](const Fov &fov, const Grid<TileType> &map) {
+            return bench::measure(101, [&] {
+                visible.clear();
+                fov.compute(map, origin, radius, visible);
+                bench::keep(visible.data()[0]);
+            }) / 1000;
+        };
+        std::printf("%-7d %16.2f %16.2f %16.2f %16.2f\n", radius,
+                time(shadowcasting, open), time(raycasting, open), time(shadowcasting, cave), time(raycasting, cave));
+    }
+    return 0;
+}
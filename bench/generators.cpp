@@ -0,0 +1,34 @@
+// Time of every map generator by map size, 4096x4096 included
+#include <cstdio>
+
+#include "map/generators.hpp"
+#include "random.hpp"
+#include "bench.hpp"
+
+int main() {
+    logger::init("bench.log");
+
+    RoomsGenerator rooms;
+    BspGenerator bsp;
+    CaveGenerator cave;
+    DrunkardGenerator drunkard;
+    struct { const char* name; const Generator &generator; } generators[] = {
+        { "rooms", rooms }, { "bsp", bsp }, { "cave", cave }, { "drunkard", drunkard },
+    };
+
+    for (int size : { 256, 1024, 4096 }) {
+        Grid<TileType> tiles { size, size, TileType::Wall };
+        for (auto &[name, generator] : generators) {
+            rng::Rng rng { 7 };
+            // Refilling the grid is part of the time, it is small next to
+            // any generator
+            auto ns = bench::measure(size >= 4096 ? 3 : 9, [&] {
+                tiles.fill(TileType::Wall);
+                generator.generate(tiles, rng);
+                bench::keep(tiles.data()[0]);
+            });
+            std::printf("%-9s %4dx%-4d %10.2f ms\n", name, size, size, ns / 1e6);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,82 @@
+// Full scans of a 1024x1024 map, the old vector-of-columns Tile layout
+// against the flat Grid and BitGrid bitplanes
+#include <cstdio>
+#include <vector>
+
+#include "map/grid.hpp"
+#include "random.hpp"
+#include "bench.hpp"
+
+namespace legacy {
+    class Tile {
+        public:
+            explicit Tile(TileType t): m_type { t } { };
+            int m_type = TileType::Empty;
+            bool m_memoized = false;
+    };
+};
+
+int main() {
+    constexpr int size = 1024;
+
+    rng::Rng rng { 42 };
+    std::vector<std::vector<legacy::Tile>> columns(size, std::vector<legacy::Tile>(size, legacy::Tile { TileType::Wall }));
+    Grid<TileType> tiles { size, size, TileType::Wall };
+    BitGrid memoized { size, size };
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            if (rng.gen_int(0, 100) < 45) {
+                columns[x][y].m_type = TileType::Empty;
+                tiles.set(x, y, TileType::Empty);
+            }
+            if (rng.gen_int(0, 100) < 30) {
+                columns[x][y].m_memoized = true;
+                memoized.set(x, y);
+            }
+        }
+    }
+
+    auto report = [](const char* what, double ns) {
+        std::printf("%-36s %8.3f ms %6.2f ns/cell\n", what, ns / 1e6, ns / (size * size));
+    };
+
+    std::printf("%dx%d: legacy %zu bytes, grid %zu + bitplane %zu bytes\n", size, size,
+            sizeof(legacy::Tile) * size * size + sizeof(std::vector<legacy::Tile>) * size,
+            tiles.size() * sizeof(TileType), memoized.size() * sizeof(BitGrid::Word));
+
+    report("walls, legacy by column", bench::measure(21, [&] {
+        int n = 0;
+        for (int x = 0; x < size; ++x)
+            for (int y = 0; y < size; ++y)
+                n += columns[x][y].m_type == TileType::Wall;
+        bench::keep(n);
+    }));
+    report("walls, legacy by row", bench::measure(21, [&] {
+        int n = 0;
+        for (int y = 0; y < size; ++y)
+            for (int x = 0; x < size; ++x)
+                n += columns[x][y].m_type == TileType::Wall;
+        bench::keep(n);
+    }));
+    report("walls, grid by row", bench::measure(21, [&] {
+        int n = 0;
+        for (int y = 0; y < size; ++y) {
+            auto row = tiles.row(y);
+            for (int x = 0; x < size; ++x)
+                n += row[x] == TileType::Wall;
+        }
+        bench::keep(n);
+    }));
+
+    report("memoized, legacy by column", bench::measure(21, [&] {
+        int n = 0;
+        for (int x = 0; x < size; ++x)
+            for (int y = 0; y < size; ++y)
+                n += columns[x][y].m_memoized;
+        bench::keep(n);
+    }));
+    report("memoized, bitplane popcount", bench::measure(21, [&] {
+        bench::keep(memoized.count());
+    }));
+    return 0;
+}
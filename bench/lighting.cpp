@@ -0,0 +1,61 @@
+// Lighting::update with 256 lights moving every frame on a 256x256 cave,
+// plus what their visibility costs in memory
+#include <cstdio>
+#include <vector>
+
+#include "map/lighting.hpp"
+#include "map/generators.hpp"
+#include "random.hpp"
+#include "bench.hpp"
+
+int main() {
+    logger::init("bench.log");
+    constexpr int size = 256;
+    constexpr int lights = 256;
+
+    Grid<TileType> cave { size, size, TileType::Wall };
+    rng::Rng rng { 13 };
+    CaveGenerator {}.generate(cave, rng);
+
+    std::vector<Vector2D> floors;
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            if (cave.get(x, y) != TileType::Wall) {
+                floors.push_back(Vector2D { x, y });
+            }
+        }
+    }
+    auto random_floor = [&] { return floors[rng.gen_int(0, static_cast<int>(floors.size()))]; };
+
+    ShadowcastingFov fov;
+    std::printf("%-7s %14s %14s %16s\n", "radius", "all move ms", "1/8 move ms", "visibility KiB");
+    for (int radius : { 4, 8, 15 }) {
+        Lighting lighting { size, size };
+        std::vector<LightId> ids;
+        for (int i = 0; i < lights; ++i) {
+            ids.push_back(lighting.add(random_floor(), radius, LightColor { 200, 120, 60 }));
+        }
+        lighting.update(fov, cave);
+
+        // Every light to a new spot, then the common case of a few
+        auto all = bench::measure(21, [&] {
+            for (auto id : ids) {
+                lighting.move(id, random_floor());
+            }
+            lighting.update(fov, cave);
+            bench::keep(lighting.intensity(size / 2, size / 2));
+        });
+        auto some = bench::measure(21, [&] {
+            for (std::size_t i = 0; i < ids.size(); i += 8) {
+                lighting.move(ids[i], random_floor());
+            }
+            lighting.update(fov, cave);
+            bench::keep(lighting.intensity(size / 2, size / 2));
+        });
+
+        BitGrid box { 2 * radius + 1, 2 * radius + 1 };
+        std::printf("%-7d %14.3f %14.3f %16.1f\n", radius, all / 1e6, some / 1e6,
+                lights * box.size() * sizeof(BitGrid::Word) / 1024.0);
+    }
+    return 0;
+}
@@ -1,46 +1,53 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
 
+#include "../ecs/ecs.hpp"
 #include "../geometry.hpp"
 
-enum class MovementDirection {
-    None, Up, Down, Left, Right
-};
-
-inline MovementDirection opposite_direction(MovementDirection direction)
-{
-    switch(direction)
-    {
-        case MovementDirection::Up:
-            return MovementDirection::Down;
-            break;
-        case MovementDirection::Down:
-            return MovementDirection::Up;
-            break;
-        case MovementDirection::Left:
-            return MovementDirection::Right;
-            break;
-        case MovementDirection::Right:
-            return MovementDirection::Left;
-            break;
-        case MovementDirection::None:
-            return MovementDirection::None;
-            break;
-    }
-};
-
 namespace ecs::components {
     class TransformComponent;
+    class SpriteComponent;
     class SpriteRenderComponent;
     class MovementComponent;
+    class DarknessComponent;
+    class TextComponent;
+    class TextRenderComponent;
+    class OffsetComponent;
+    class LightComponent;
+
+    // Every component type the game uses, ids are the positions in this list
+    using ComponentTypes = TypeList<
+        TransformComponent,
+        SpriteComponent,
+        SpriteRenderComponent,
+        MovementComponent,
+        DarknessComponent,
+        TextComponent,
+        TextRenderComponent,
+        OffsetComponent,
+        LightComponent
+    >;
 
     using SetPosLambda = std::function<void(Vector2D)>;
     using GetPosLambda = std::function<Vector2D()>;
     using CanMoveLambda = std::function<bool(Vector2D, MovementDirection)>;
     using VisibleLambda = std::function<bool(int, int)>;
     using MemoizedLambda = std::function<bool(int, int)>;
+    using LightLambda = std::function<std::uint8_t(int, int)>;
+    using RevisionLambda = std::function<std::uint32_t()>;
     using GetTextLambda = std::function<std::string()>;
+
+    // SpriteBatch layers, lower ones are drawn first
+    enum DrawLayer : int {
+        SpritesLayer
+    };
+};
+
+namespace ecs {
+    template <typename T>
+    struct ComponentId : type_index<T, components::ComponentTypes> { };
 };
 
 #include "transform.hpp"
@@ -51,3 +58,4 @@ namespace ecs::components {
 #include "text.hpp"
 #include "text_render.hpp"
 #include "offset.hpp"
+#include "light.hpp"
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <algorithm>
 #include <memory>
+#include <vector>
 
 #include "../sdl/sdl.hpp"
 #include "../ecs/ecs.hpp"
@@ -8,57 +10,146 @@
 
 namespace ecs::components
 {
-    class DarknessComponent : public Component
+    // Fog of war as one streaming texture with a texel per map cell, its
+    // alpha encoding lit, explored or unknown. The cells on screen are only
+    // recomputed when the map's shade revision or the camera moved, then
+    // just the box of texels that changed is uploaded. The overlay is drawn
+    // with a single scaled copy.
+    class DarknessComponent
     {
     private:
         int m_width;
         int m_height;
         VisibleLambda m_is_visible;
         MemoizedLambda m_is_memoized;
-        std::shared_ptr<Entity> m_offset;
+        LightLambda m_intensity;
+        RevisionLambda m_revision;
+        // What the texels were last computed for
+        bool m_dirty = true;
+        std::uint32_t m_computed_revision = 0;
+        SDL_Rect m_computed_cells { 0, 0, 0, 0 };
+        // Last uploaded RGBA8888 texels
+        std::vector<Uint32> m_texels;
+        std::unique_ptr<sdl::Texture> m_texture;
+
+        Uint8 alpha(int x, int y) const
+        {
+            if (m_is_visible(x, y)) {
+                // Visible cells are shaded by the light reaching them,
+                // never darker than remembered ones
+                return static_cast<Uint8>((255 - m_intensity(x, y)) * 150 / 255);
+            }
+            return m_is_memoized(x, y) ? 150 : 255;
+        }
+
+        void create_texture(sdl::Window& window)
+        {
+            m_texture = std::make_unique<sdl::Texture>(window.get_renderer(), m_width, m_height, SDL_TEXTUREACCESS_STREAMING);
+            m_texture->set_blend_mode(SDL_BLENDMODE_BLEND);
+#if SDL_VERSION_ATLEAST(2, 0, 12)
+            // Hard tile edges, like the per tile overlay had
+            SDL_SetTextureScaleMode(*m_texture, SDL_ScaleModeNearest);
+#endif
+            m_texels.assign(static_cast<std::size_t>(m_width) * m_height, 0xFF);
+
+            int pitch;
+            auto pixels = m_texture->lock(SDL_Rect { 0, 0, m_width, m_height }, pitch);
+            for (int y = 0; y < m_height; ++y) {
+                std::copy_n(m_texels.data() + static_cast<std::size_t>(y) * m_width, m_width,
+                        reinterpret_cast<Uint32*>(reinterpret_cast<Uint8*>(pixels) + y * pitch));
+            }
+            m_texture->unlock();
+        }
 
     public:
-        DarknessComponent(int width, int height, VisibleLambda vfn, MemoizedLambda mfn, std::shared_ptr<Entity> offset)
-        : m_width { width }, m_height { height }, m_is_visible { vfn }, m_is_memoized { mfn }, m_offset { offset }
+        using Requires = TypeList<TransformComponent, SpriteComponent>;
+
+        DarknessComponent(int width, int height, VisibleLambda vfn, MemoizedLambda mfn, LightLambda lfn, RevisionLambda rfn)
+        : m_width { width }, m_height { height }, m_is_visible { vfn }, m_is_memoized { mfn }, m_intensity { lfn },
+          m_revision { rfn }
         {  }
-        virtual ~DarknessComponent() override {  }
 
-        void init() override
+        // The lambdas now read another map, whose revisions say nothing
+        // about the texels
+        void invalidate() { m_dirty = true; }
+
+        // The renderer lost its textures (SDL_RENDER_DEVICE_RESET,
+        // SDL_RENDER_TARGETS_RESET): recreate and refill on the next draw
+        void release_texture()
         {
-            m_entity->assert_component<TransformComponent>("DarknessComponent");
-            m_entity->assert_component<SpriteComponent>("DarknessComponent");
+            m_texture.reset();
+            m_dirty = true;
         }
-        void draw() override
-        {
 
-            auto window = m_entity->get_component<SpriteComponent>()->m_window;
-            auto sprite = m_entity->get_component<SpriteComponent>()->m_sprite;
+        void draw(const Camera& camera, const SpriteComponent& sprite_component)
+        {
+            auto& window = sprite_component.m_window;
+            auto& sprite = sprite_component.m_sprite;
             auto sprite_w = sprite->get_w();
             auto sprite_h = sprite->get_h();
 
-            Vector2D offset_pos;
-            auto offset = m_offset->get_component<OffsetComponent>();
-            auto [ofx, ofy] = m_offset->get_component<TransformComponent>()->get_pos();
+            auto [ofx, ofy] = camera.offset;
 
-            int xx, yy;
-            for (int x = 0; x < m_width; ++x)
-            {
-                for (int y = 0; y < m_height; ++y)
-                {
-                    if (offset->in_fov(x, y) && !m_is_visible(x, y)) {
-                        if (m_is_memoized(x, y)) {
-                            sprite->set_alpha(150);
-                        } else {
-                            sprite->set_alpha(255);
-                        }
+            // Only the cells on screen
+            int x0 = camera.x0;
+            int y0 = camera.y0;
+            int x1 = std::min(m_width, camera.x1);
+            int y1 = std::min(m_height, camera.y1);
+            if (x0 >= x1 || y0 >= y1) return;
+
+            if (!m_texture) {
+                create_texture(*window);
+            }
 
-                        xx = x + ofx;
-                        yy = y + ofy;
+            SDL_Rect cells { x0, y0, x1 - x0, y1 - y0 };
+            auto revision = m_revision();
+            bool moved = cells.x != m_computed_cells.x || cells.y != m_computed_cells.y
+                || cells.w != m_computed_cells.w || cells.h != m_computed_cells.h;
+            if (m_dirty || moved || revision != m_computed_revision) {
+                compute(x0, y0, x1, y1);
+                m_dirty = false;
+                m_computed_revision = revision;
+                m_computed_cells = cells;
+            }
 
-                        sprite->render(window->get_renderer(), 0, 0, xx*sprite_w, yy*sprite_h, 0, NULL);
+            SDL_Rect dst { (x0 + ofx) * sprite_w, (y0 + ofy) * sprite_h, (x1 - x0) * sprite_w, (y1 - y0) * sprite_h };
+            SDL_RenderCopy(window->get_renderer(), *m_texture, &cells, &dst);
+        }
+
+    private:
+        // Recomputes the cells in [x0, x1) x [y0, y1) and uploads those
+        // which changed
+        void compute(int x0, int y0, int x1, int y1)
+        {
+            // Box of texels which changed, empty when dx0 >= dx1
+            int dx0 = x1, dy0 = y1, dx1 = x0, dy1 = y0;
+            for (int y = y0; y < y1; ++y)
+            {
+                auto row = m_texels.data() + static_cast<std::size_t>(y) * m_width;
+                for (int x = x0; x < x1; ++x)
+                {
+                    // Black, only the alpha byte varies
+                    Uint32 texel = alpha(x, y);
+                    if (row[x] != texel) {
+                        row[x] = texel;
+                        dx0 = std::min(dx0, x);
+                        dy0 = std::min(dy0, y);
+                        dx1 = std::max(dx1, x + 1);
+                        dy1 = std::max(dy1, y + 1);
                     }
                 }
             }
+
+            if (dx0 < dx1)
+            {
+                int pitch;
+                auto pixels = m_texture->lock(SDL_Rect { dx0, dy0, dx1 - dx0, dy1 - dy0 }, pitch);
+                for (int y = dy0; y < dy1; ++y) {
+                    std::copy_n(m_texels.data() + static_cast<std::size_t>(y) * m_width + dx0, dx1 - dx0,
+                            reinterpret_cast<Uint32*>(reinterpret_cast<Uint8*>(pixels) + (y - dy0) * pitch));
+                }
+                m_texture->unlock();
+            }
         }
     };
 };
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "../ecs/ecs.hpp"
+#include "../map/lighting.hpp"
+#include "transform.hpp"
+
+namespace ecs::components
+{
+    // Point light following the entity's transform. The light itself lives
+    // in the level's Lighting, this only holds its handle.
+    class LightComponent
+    {
+    private:
+        int m_radius;
+        LightColor m_color;
+        LightId m_id = invalidLight;
+    public:
+        using Requires = TypeList<TransformComponent>;
+
+        LightComponent(int radius, LightColor color)
+        : m_radius { radius }, m_color { color }
+        { };
+        // For a light registered up front, see generate_level
+        LightComponent(int radius, LightColor color, LightId id)
+        : m_radius { radius }, m_color { color }, m_id { id }
+        { };
+
+        LightId get_id() const { return m_id; }
+
+        // Registers the light on first call, afterwards moves it when the
+        // transform changed after `since`
+        void sync(Lighting& lighting, const TransformComponent& transform, Tick since = 0)
+        {
+            if (m_id == invalidLight)
+            {
+                m_id = lighting.add(transform.get_pos(), m_radius, m_color);
+                return;
+            }
+
+            if (transform.changed_since(since))
+            {
+                lighting.move(m_id, transform.get_pos());
+            }
+        }
+
+        // The Lighting it was registered with is gone (new level)
+        void detach() { m_id = invalidLight; }
+    };
+};
@@ -6,20 +6,17 @@
 
 namespace ecs::components
 {
-    class MovementComponent : public Component
+    class MovementComponent
     {
     private:
     public:
-        MovementComponent() { };
-        virtual ~MovementComponent() override {  };
+        using Requires = TypeList<TransformComponent>;
 
-        void init() override {
-            m_entity->assert_component<TransformComponent>("Movement");
-        }
+        MovementComponent() { };
 
-        void move(MovementDirection direction)
+        void move(TransformComponent& transform, MovementDirection direction)
         {
-            Vector2D pos = m_entity->get_component<TransformComponent>()->get_pos();
+            Vector2D pos = transform.get_pos();
 
             switch(direction)
             {
@@ -39,7 +36,7 @@ namespace ecs::components
                     break;
             }
 
-            m_entity->get_component<TransformComponent>()->set_pos(pos);
+            transform.set_pos(pos);
         }
     };
 };
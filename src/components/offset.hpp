@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <memory>
 
 #include "../ecs/ecs.hpp"
@@ -7,51 +8,44 @@
 
 namespace ecs::components
 {
-    class OffsetComponent : public Component
+    class OffsetComponent
     {
     private:
         Vector2D m_playfield;
         Vector2D m_map_size;
-        std::shared_ptr<Entity> m_player;
+        EntityId m_player;
+        Vector2D m_offset { 0, 0 };
     public:
-        OffsetComponent(Vector2D l, Vector2D m, std::shared_ptr<Entity> p)
+        using Requires = TypeList<TransformComponent>;
+
+        OffsetComponent(Vector2D l, Vector2D m, EntityId p)
         : m_playfield { l }, m_map_size { m }, m_player { p }
         { };
-        virtual ~OffsetComponent() override {  };
-
-        void init() override {
-            m_entity->assert_component<TransformComponent>("Offset");
-        }
-
-        bool in_fov(Vector2D pos)
-        {
-            auto offset = m_entity->get_component<TransformComponent>()->get_pos();
-            auto new_pos = pos + offset;
-            return new_pos.x >= 0 && new_pos.y >= 0 && new_pos.x < m_playfield.x && new_pos.y < m_playfield.y;
-        }
 
-        bool in_fov(int x, int y)
-        {
-            return in_fov(Vector2D { x, y });
-        }
+        const Vector2D get_offset() const { return m_offset; }
+        const Vector2D get_playfield() const { return m_playfield; }
 
-        void reset()
+        // Computed once per frame, renderers cull against it
+        Camera camera() const
         {
-            auto offset = m_entity->get_component<TransformComponent>()->get_pos();
-            auto player = m_player->get_component<TransformComponent>()->get_pos();
-
-            offset.x = m_playfield.x/2 - player.x;
-            offset.y = m_playfield.y/2 - player.y;
-
-            m_entity->get_component<TransformComponent>()->set_pos(offset);
+            return Camera {
+                m_offset,
+                m_playfield,
+                std::max(0, -m_offset.x),
+                std::max(0, -m_offset.y),
+                std::min(m_map_size.x, m_playfield.x - m_offset.x),
+                std::min(m_map_size.y, m_playfield.y - m_offset.y),
+            };
         }
 
-        void update() override
+        // Only recomputes when the player moved after `since`
+        void update(World& world, TransformComponent& transform, Tick since = 0)
         {
-            reset();
+            auto player_transform = world.get_component<TransformComponent>(m_player);
+            if (!player_transform || !player_transform->changed_since(since)) return;
 
-            auto offset = m_entity->get_component<TransformComponent>()->get_pos();
-            auto player = m_player->get_component<TransformComponent>()->get_pos();
+            auto player = player_transform->get_pos();
+            Vector2D offset { m_playfield.x/2 - player.x, m_playfield.y/2 - player.y };
 
             if (offset.x > 0) {
                 offset.x = 0;
@@ -69,7 +63,8 @@ namespace ecs::components
                 offset.y = -(m_map_size.y - m_playfield.y);
             }
 
-            m_entity->get_component<TransformComponent>()->set_pos(offset);
+            m_offset = offset;
+            transform.set_pos(offset);
         }
     };
 };
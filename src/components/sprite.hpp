@@ -7,7 +7,7 @@
 
 namespace ecs::components
 {
-    class SpriteComponent : public Component
+    class SpriteComponent
     {
     public:
         std::shared_ptr<sdl::Window> m_window;
@@ -16,6 +16,5 @@ namespace ecs::components
         SpriteComponent(std::shared_ptr<sdl::Window> w, std::shared_ptr<sdl::Sprite> sprite)
         : m_window { w }, m_sprite { sprite }
         {  };
-        virtual ~SpriteComponent() override {  };
     };
 };
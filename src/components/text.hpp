@@ -7,7 +7,7 @@
 
 namespace ecs::components
 {
-    class TextComponent : public Component
+    class TextComponent
     {
     private:
         std::string m_text;
@@ -24,11 +24,8 @@ namespace ecs::components
           m_color { color },
           m_texture { m_window->render_text(m_text, m_color) }
         {  };
-        virtual ~TextComponent() override {  };
 
-        void init() override { update(); }
-
-        void update() override
+        void update()
         {
             auto txt = m_get_text();
             if (txt == m_text) return;
@@ -10,25 +10,18 @@
 
 namespace ecs::components
 {
-    class TextRenderComponent : public Component
+    class TextRenderComponent
     {
     private:
     public:
-        TextRenderComponent() {  };
-
-        virtual ~TextRenderComponent() override {  };
+        using Requires = TypeList<TransformComponent, TextComponent>;
 
-        void init() override {
-            m_entity->assert_component<TransformComponent>("TextRenderer");
-        }
-
-        void draw() override {
-            auto [x, y] = m_entity->get_component<TransformComponent>()->get_pos();
+        TextRenderComponent() {  };
 
-            auto window = m_entity->get_component<TextComponent>()->m_window;
-            auto texture = m_entity->get_component<TextComponent>()->m_texture;
+        void draw(const TransformComponent& transform, const TextComponent& text) {
+            auto [x, y] = transform.get_pos();
 
-            texture->render(window->get_renderer(), x, y);
+            text.m_texture->render(text.m_window->get_renderer(), x, y);
         }
     };
 };
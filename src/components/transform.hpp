@@ -7,18 +7,22 @@
 
 namespace ecs::components
 {
-    class TransformComponent : public Component
+    class TransformComponent : public Tracked
     {
     protected:
         Vector2D pos;
     public:
         TransformComponent(Vector2D p) : pos { p } {  };
         TransformComponent(int x, int y) : pos { x, y } {  };
-        virtual ~TransformComponent() override {  };
 
-        void set_pos(Vector2D np) { pos = np; };
-        const Vector2D get_pos() { return pos; };
-        const int get_x() { return pos.x; };
-        const int get_y() { return pos.y; };
+        void set_pos(Vector2D np)
+        {
+            if (np == pos) return;
+            pos = np;
+            mark_changed();
+        };
+        const Vector2D get_pos() const { return pos; };
+        const int get_x() const { return pos.x; };
+        const int get_y() const { return pos.y; };
     };
 };
@@ -2,22 +2,45 @@
 #include <stdio.h>
 #include <iostream>
 #include <locale.h>
+#include <stdlib.h>
+#include <new>
 
 #include "random.hpp"
 /* #include "game.hpp" */
 #include "game.hpp"
 #include "sdl/sdl.hpp"
 #include "logging.hpp"
+#include "heap.hpp"
 
 using namespace std;
 
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 640;
 
+#ifndef NDEBUG
+// Debug builds count every global allocation, Game::loop logs them per
+// frame. new[] and nothrow new forward here.
+void* operator new(size_t size)
+{
+    heap::allocations().fetch_add(1, memory_order_relaxed);
+    if (auto p = malloc(size ? size : 1))
+        return p;
+    throw bad_alloc {};
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+#endif
+
 int main()
 {
     logger::init("turbo-potato.log");
-    rng::init();
+    // TURBO_POTATO_SEED replays a previous run
+    if (auto seed = getenv("TURBO_POTATO_SEED"))
+        rng::init(strtoull(seed, nullptr, 10));
+    else
+        rng::init();
+    logger::info("Random seed", rng::seed());
 
     sdl::init();
     atexit(SDL_Quit);
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <utility>
+
+#include "ecs.hpp"
+
+namespace ecs
+{
+    // Entity created through a CommandBuffer which does not exist yet.
+    // Only meaningful to the buffer which handed it out.
+    class PendingEntity
+    {
+    private:
+        std::uint32_t m_index;
+    public:
+        constexpr explicit PendingEntity(std::uint32_t index) : m_index { index } { }
+        constexpr std::uint32_t index() const { return m_index; }
+    };
+
+    // Records structural changes (create, destroy, add/remove component)
+    // while systems iterate and applies them, in recording order, at a single
+    // sync point with flush(). Commands are bump allocated from the buffer's
+    // own arena which is rewound after every flush, so a warmed up buffer
+    // does not allocate. A buffer must only be used by one thread at a time;
+    // the Scheduler hands every system its own.
+    class CommandBuffer
+    {
+    private:
+        struct Target
+        {
+            EntityId entity;
+            std::uint32_t pending = ~0u;
+        };
+
+        class Command
+        {
+        public:
+            virtual ~Command() { }
+            virtual void apply(World& world, CommandBuffer& buffer) = 0;
+        };
+
+        class CreateCommand : public Command
+        {
+        public:
+            void apply(World& world, CommandBuffer& buffer) override
+            {
+                buffer.m_created.push_back(world.create());
+            }
+        };
+
+        class DestroyCommand : public Command
+        {
+        private:
+            Target m_target;
+        public:
+            explicit DestroyCommand(Target t) : m_target { t } { }
+
+            void apply(World& world, CommandBuffer& buffer) override
+            {
+                auto e = buffer.resolve(m_target);
+                if (world.is_alive(e)) world.destroy(e);
+            }
+        };
+
+        template <typename T>
+        class AddCommand : public Command
+        {
+        private:
+            Target m_target;
+            T m_component;
+        public:
+            AddCommand(Target t, T&& c) : m_target { t }, m_component { std::move(c) } { }
+
+            void apply(World& world, CommandBuffer& buffer) override
+            {
+                auto e = buffer.resolve(m_target);
+                if (world.is_alive(e)) world.add_component<T>(e, std::move(m_component));
+            }
+        };
+
+        template <typename T>
+        class RemoveCommand : public Command
+        {
+        private:
+            Target m_target;
+        public:
+            explicit RemoveCommand(Target t) : m_target { t } { }
+
+            void apply(World& world, CommandBuffer& buffer) override
+            {
+                auto e = buffer.resolve(m_target);
+                if (world.is_alive(e)) world.remove_component<T>(e);
+            }
+        };
+
+        Arena m_arena;
+        std::pmr::vector<Command*> m_commands { heap() };
+        std::pmr::vector<EntityId> m_created { heap() };
+        std::uint32_t m_pending = 0;
+
+        EntityId resolve(Target t) const
+        {
+            return t.pending == ~0u ? t.entity : m_created[t.pending];
+        }
+
+        template <typename C, typename... TArgs>
+        void record(TArgs&&... mArgs)
+        {
+            void* p = m_arena.allocate(sizeof(C), alignof(C));
+            m_commands.push_back(new (p) C(std::forward<TArgs>(mArgs)...));
+        }
+
+        void reset()
+        {
+            for (auto c : m_commands) c->~Command();
+            m_commands.clear();
+            m_created.clear();
+            m_pending = 0;
+            m_arena.reset();
+        }
+
+    public:
+        explicit CommandBuffer(std::size_t chunk_size = 64 << 10) : m_arena { chunk_size } { }
+        ~CommandBuffer() { reset(); }
+
+        CommandBuffer(const CommandBuffer&) = delete;
+        CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+        bool empty() const { return m_commands.empty(); }
+        std::size_t size() const { return m_commands.size(); }
+
+        PendingEntity create()
+        {
+            record<CreateCommand>();
+            return PendingEntity { m_pending++ };
+        }
+
+        void destroy(EntityId e) { record<DestroyCommand>(Target { e }); }
+        void destroy(PendingEntity e) { record<DestroyCommand>(Target { nullEntity, e.index() }); }
+
+        template <typename T, typename... TArgs>
+        void add_component(EntityId e, TArgs&&... mArgs)
+        {
+            record<AddCommand<T>>(Target { e }, T(std::forward<TArgs>(mArgs)...));
+        }
+
+        template <typename T, typename... TArgs>
+        void add_component(PendingEntity e, TArgs&&... mArgs)
+        {
+            record<AddCommand<T>>(Target { nullEntity, e.index() }, T(std::forward<TArgs>(mArgs)...));
+        }
+
+        template <typename T>
+        void remove_component(EntityId e) { record<RemoveCommand<T>>(Target { e }); }
+
+        template <typename T>
+        void remove_component(PendingEntity e) { record<RemoveCommand<T>>(Target { nullEntity, e.index() }); }
+
+        // Applies everything recorded so far. Free when nothing was recorded.
+        // Commands against entities destroyed in the meantime are dropped.
+        // The buffer is empty afterwards even when a command throws: the
+        // ones before it already ran and must not run again, the rest are
+        // dropped with it.
+        void flush(World& world)
+        {
+            if (m_commands.empty()) return;
+
+            struct Rewind
+            {
+                CommandBuffer& buffer;
+                ~Rewind() { buffer.reset(); }
+            } rewind { *this };
+
+            for (auto c : m_commands) c->apply(world, *this);
+        }
+    };
+};
@@ -1,12 +1,15 @@
 #pragma once
 
+#include <atomic>
 #include <bitset>
+#include <cstdint>
 #include <memory>
 #include <vector>
 #include <array>
 #include <stdio.h>
 #include <iostream>
 #include <algorithm>
+#include <type_traits>
 
 #include "../logging.hpp"
 
@@ -14,175 +17,119 @@ namespace ecs
 {
     constexpr std::size_t maxComponents = 32;
 
-    class Entity;
-    class Component;
-    class System;
-    class Group;
-
     using ComponentTypeID = size_t;
 
-    inline ComponentTypeID gen_component_type_id()
+    template <typename... Ts>
+    struct TypeList
     {
-        static ComponentTypeID compID = 0;
-        return ++compID;
-    }
+        static constexpr std::size_t size = sizeof...(Ts);
+    };
+
+    template <typename T>
+    inline constexpr bool dependent_false = false;
+
+    template <typename T, typename List>
+    struct type_index;
+
+    template <typename T, typename... Ts>
+    struct type_index<T, TypeList<T, Ts...>> : std::integral_constant<std::size_t, 0> { };
+
+    template <typename T, typename U, typename... Ts>
+    struct type_index<T, TypeList<U, Ts...>>
+    : std::integral_constant<std::size_t, 1 + type_index<T, TypeList<Ts...>>::value> { };
+
+    template <typename T>
+    struct type_index<T, TypeList<>>
+    {
+        static_assert(dependent_false<T>, "Component type is not registered in the component type list");
+    };
+
+    template <typename T, typename List>
+    struct type_in_list;
+
+    template <typename T, typename... Ts>
+    struct type_in_list<T, TypeList<Ts...>> : std::bool_constant<(std::is_same_v<T, Ts> || ...)> { };
 
+    // Component ids are assigned at compile time from the program's
+    // declared list of component types, i.e. the game defines
+    //
+    //     template <typename T>
+    //     struct ecs::ComponentId : ecs::type_index<T, ComponentTypes> { };
+    //
+    // once, before any World touches a component.
     template <typename T>
-    inline ComponentTypeID get_component_type_id() noexcept
+    struct ComponentId;
+
+    template <typename T>
+    constexpr ComponentTypeID get_component_type_id() noexcept
     {
-        static ComponentTypeID id = gen_component_type_id();
+        constexpr ComponentTypeID id = ComponentId<T>::value;
+        static_assert(id < maxComponents, "Too many component types, raise ecs::maxComponents");
         return id;
     }
 
-    using ComponentArray = std::array<std::shared_ptr<Component>, maxComponents>;
     using ComponentBitSet = std::bitset<maxComponents>;
 
-    class Component
+    template <typename... Ts>
+    inline ComponentBitSet component_mask()
     {
-    protected:
-        Entity* m_entity;
-    public:
-        Component() {  };
-        virtual ~Component() {  };
+        ComponentBitSet mask;
+        (mask.set(get_component_type_id<Ts>()), ...);
+        return mask;
+    }
 
-        virtual void init() { }
-        virtual void update() { }
-        virtual void draw() { }
+    template <typename... Ts>
+    inline ComponentBitSet component_mask(TypeList<Ts...>)
+    {
+        return component_mask<Ts...>();
+    }
 
-        void set_entity(Entity* e)
-        { m_entity = e; }
-    };
+    // Components declare what else an entity must hold for them to work:
+    //
+    //     using Requires = ecs::TypeList<TransformComponent>;
+    template <typename T, typename = void>
+    struct requirements_of { using type = TypeList<>; };
 
-    class Entity
-    {
-    private:
-        bool m_active = true;
-        ComponentArray m_components;
-        ComponentBitSet m_component_bit_set;
-    public:
-        Entity() { };
-        virtual ~Entity() {  };
-
-        void init()
-        { for (auto& c : m_components) if (c) c->init();  }
-
-        void update()
-        { for (auto& c : m_components) if (c) c->update();  }
-
-        void draw()
-        { for (auto& c : m_components) if (c) c->draw(); }
-
-        bool is_active() const { return m_active; }
-        void destroy() { m_active = false; }
-
-        template <typename T>
-        bool has_component() const
-        {
-            return m_component_bit_set.test(get_component_type_id<T>());
-        }
-
-        template <typename T>
-        void assert_component(std::string label) const
-        {
-            std::string name = typeid(T).name();
-            if (!has_component<T>()) {
-                throw std::runtime_error("Entity needs " + name + " component to be present for " + label + " component");
-            }
-        }
-
-        template <typename T, typename... TArgs>
-        std::shared_ptr<T> add_component(TArgs&&... mArgs)
-        {
-            std::shared_ptr<T> c = std::make_shared<T>(mArgs...);
-            c->set_entity(this);
-            c->init();
-
-            m_components[get_component_type_id<T>()] = c;
-            m_component_bit_set.set(get_component_type_id<T>());
-
-            return c;
-        }
-
-        template <typename T>
-        std::shared_ptr<T> get_component() {
-            auto ptr = m_components[get_component_type_id<T>()];
-            return std::static_pointer_cast<T>(ptr);
-        }
-    };
+    template <typename T>
+    struct requirements_of<T, std::void_t<typename T::Requires>> { using type = typename T::Requires; };
+
+    template <typename T, typename List, typename Required = typename requirements_of<T>::type>
+    struct requirements_met;
 
-    class Group
+    template <typename T, typename List, typename... Rs>
+    struct requirements_met<T, List, TypeList<Rs...>> : std::bool_constant<(type_in_list<Rs, List>::value && ...)> { };
+
+    // Change detection. A global, monotonically increasing tick stamps every
+    // write to a Tracked component; a reader remembers the tick it last ran at
+    // and only looks at components stamped after it.
+    using Tick = std::uint32_t;
+
+    inline std::atomic<Tick>& change_tick()
     {
-    private:
-        std::vector<std::shared_ptr<Entity>> m_entities;
-    public:
-        Group() { };
-        ~Group() { };
-
-        void update()
-        {
-            for (auto& e : m_entities) e->update();
-        }
-
-        void draw()
-        {
-            for (auto& e : m_entities) e->draw();
-        }
-
-        void destroy_all()
-        {
-            for (auto& e : m_entities) e->destroy();
-        }
-
-        std::vector<std::shared_ptr<Entity>>& entities()
-        {
-            return m_entities;
-        }
-
-        void collect_garbage()
-        {
-            m_entities.erase(
-                    std::remove_if(
-                        m_entities.begin(), m_entities.end(),
-                        [](const std::shared_ptr<Entity> e) { return !e->is_active(); }),
-                    m_entities.end());
-        }
-
-        std::shared_ptr<Entity> add_entity()
-        {
-            std::shared_ptr<Entity> e = std::make_shared<Entity>();
-            m_entities.push_back(e);
-            return e;
-        };
-    };
+        static std::atomic<Tick> tick { 1 };
+        return tick;
+    }
+
+    inline Tick current_tick() { return change_tick().load(std::memory_order_relaxed); }
 
-    class System
+    // Returns the tick a reader should remember as its last run, writes
+    // from now on are stamped later than it.
+    inline Tick advance_tick() { return change_tick().fetch_add(1, std::memory_order_relaxed); }
+
+    // Base for components which want change detection. Newly created
+    // components count as changed.
+    class Tracked
     {
     private:
-        std::vector<std::shared_ptr<Group>> m_groups;
+        Tick m_changed_tick = current_tick();
     public:
-        System() { };
-        ~System() { };
-
-        void update()
-        {
-            for (auto& g : m_groups) g->update();
-        }
-
-        void draw()
-        {
-            for (auto& g : m_groups) g->draw();
-        }
-
-        void collect_garbage()
-        {
-            for (auto& g : m_groups) g->collect_garbage();
-        }
-
-        std::shared_ptr<Group> add_group()
-        {
-            std::shared_ptr<Group> g = std::make_shared<Group>();
-            m_groups.push_back(g);
-            return g;
-        };
+        void mark_changed() { m_changed_tick = current_tick(); }
+        Tick changed_tick() const { return m_changed_tick; }
+        bool changed_since(Tick tick) const { return m_changed_tick > tick; }
     };
 };
+
+#include "world.hpp"
+#include "commands.hpp"
+#include "scheduler.hpp"
+#include "view.hpp"
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+namespace ecs
+{
+    struct AllocationStats
+    {
+        std::atomic<std::size_t> allocations { 0 };
+        std::atomic<std::size_t> deallocations { 0 };
+        std::atomic<std::size_t> bytes { 0 };
+    };
+
+    // Counters for everything the ECS takes from the global allocator.
+    // Sample `allocations` around a frame to check it stays allocation free.
+    inline AllocationStats& allocation_stats()
+    {
+        static AllocationStats stats;
+        return stats;
+    }
+
+    // Forwards to an upstream resource, counting every call.
+    class CountingResource : public std::pmr::memory_resource
+    {
+    private:
+        std::pmr::memory_resource* m_upstream;
+    public:
+        explicit CountingResource(std::pmr::memory_resource* upstream) : m_upstream { upstream } { }
+
+    protected:
+        void* do_allocate(std::size_t bytes, std::size_t align) override
+        {
+            auto& stats = allocation_stats();
+            stats.allocations.fetch_add(1, std::memory_order_relaxed);
+            stats.bytes.fetch_add(bytes, std::memory_order_relaxed);
+            return m_upstream->allocate(bytes, align);
+        }
+
+        void do_deallocate(void* p, std::size_t bytes, std::size_t align) override
+        {
+            allocation_stats().deallocations.fetch_add(1, std::memory_order_relaxed);
+            m_upstream->deallocate(p, bytes, align);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+    };
+
+    // Default resource of every World: the global heap, counted.
+    inline std::pmr::memory_resource* heap()
+    {
+        static CountingResource resource { std::pmr::new_delete_resource() };
+        return &resource;
+    }
+
+    // Bump allocator for data sharing one lifetime, e.g. everything belonging
+    // to a dungeon level. Deallocation is a no-op; reset() rewinds the arena
+    // in one go while keeping its chunks, so the next level is carved out of
+    // the same memory without touching the global allocator again.
+    // Not thread safe.
+    class Arena : public std::pmr::memory_resource
+    {
+    private:
+        struct Chunk
+        {
+            std::byte* data;
+            std::size_t size;
+        };
+
+        std::pmr::memory_resource* m_upstream;
+        std::size_t m_chunk_size;
+        std::vector<Chunk> m_chunks;
+        std::size_t m_current = 0;
+        std::size_t m_offset = 0;
+        std::size_t m_used = 0;
+
+        void add_chunk(std::size_t min_size)
+        {
+            auto size = std::max(m_chunk_size, min_size);
+            auto data = static_cast<std::byte*>(m_upstream->allocate(size, alignof(std::max_align_t)));
+            m_chunks.push_back(Chunk { data, size });
+        }
+
+    public:
+        explicit Arena(std::size_t chunk_size = 1 << 20, std::pmr::memory_resource* upstream = heap())
+        : m_upstream { upstream }, m_chunk_size { chunk_size }
+        { }
+
+        ~Arena() { release(); }
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        // Forget every allocation, keep the chunks for reuse
+        void reset()
+        {
+            m_current = 0;
+            m_offset = 0;
+            m_used = 0;
+        }
+
+        // Give every chunk back to the upstream resource
+        void release()
+        {
+            for (auto& c : m_chunks) m_upstream->deallocate(c.data, c.size, alignof(std::max_align_t));
+            m_chunks.clear();
+            reset();
+        }
+
+        std::size_t used() const { return m_used; }
+
+        std::size_t capacity() const
+        {
+            std::size_t n = 0;
+            for (auto& c : m_chunks) n += c.size;
+            return n;
+        }
+
+    protected:
+        void* do_allocate(std::size_t bytes, std::size_t align) override
+        {
+            for (;;)
+            {
+                if (m_current < m_chunks.size())
+                {
+                    auto& chunk = m_chunks[m_current];
+                    void* p = chunk.data + m_offset;
+                    std::size_t space = chunk.size - m_offset;
+                    if (std::align(align, bytes, p, space))
+                    {
+                        m_offset = static_cast<std::byte*>(p) - chunk.data + bytes;
+                        m_used += bytes;
+                        return p;
+                    }
+
+                    // Skip to the next retained chunk large enough
+                    ++m_current;
+                    m_offset = 0;
+                    continue;
+                }
+
+                add_chunk(bytes + align);
+            }
+        }
+
+        void do_deallocate(void*, std::size_t, std::size_t) override { }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+    };
+
+    // unique_ptr deleter for objects placed in a memory resource
+    struct ResourceDeleter
+    {
+        std::pmr::memory_resource* resource = nullptr;
+        std::size_t size = 0;
+        std::size_t align = 0;
+
+        template <typename T>
+        void operator()(T* p) const
+        {
+            p->~T();
+            resource->deallocate(p, size, align);
+        }
+    };
+
+    template <typename T>
+    using resource_ptr = std::unique_ptr<T, ResourceDeleter>;
+
+    template <typename T, typename... TArgs>
+    resource_ptr<T> make_in(std::pmr::memory_resource* resource, TArgs&&... mArgs)
+    {
+        void* p = resource->allocate(sizeof(T), alignof(T));
+        try
+        {
+            return resource_ptr<T>(new (p) T(std::forward<TArgs>(mArgs)...), ResourceDeleter { resource, sizeof(T), alignof(T) });
+        }
+        catch (...)
+        {
+            resource->deallocate(p, sizeof(T), alignof(T));
+            throw;
+        }
+    }
+};
@@ -0,0 +1,355 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ecs.hpp"
+
+namespace ecs
+{
+    using Task = std::function<void()>;
+
+    // Counts outstanding tasks submitted under it, remembers the first
+    // exception thrown by one of them so ThreadPool::wait can rethrow it.
+    class TaskGroup
+    {
+    private:
+        std::atomic<std::size_t> m_pending { 0 };
+        std::mutex m_error_mutex;
+        std::exception_ptr m_error;
+
+        friend class ThreadPool;
+    public:
+        bool done() const { return m_pending.load(std::memory_order_acquire) == 0; }
+    };
+
+    // Work stealing pool. Every worker owns a deque, pops its own work from
+    // the back and steals from the front of the others when it runs dry.
+    // Threads waiting on a TaskGroup help executing tasks instead of blocking,
+    // so nested parallel_for calls cannot deadlock. A pool with zero workers
+    // runs everything on the waiting thread.
+    class ThreadPool
+    {
+    private:
+        struct Queue
+        {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        std::vector<std::unique_ptr<Queue>> m_queues;
+        std::vector<std::thread> m_threads;
+        std::mutex m_sleep_mutex;
+        std::condition_variable m_wake;
+        std::atomic<std::size_t> m_queued { 0 };
+        std::atomic<std::size_t> m_next_queue { 0 };
+        std::atomic<bool> m_stop { false };
+
+        static inline thread_local ThreadPool* t_pool = nullptr;
+        static inline thread_local std::size_t t_index = 0;
+
+        bool try_pop(std::size_t self, Task& out)
+        {
+            {
+                auto& own = *m_queues[self];
+                std::lock_guard<std::mutex> guard(own.mutex);
+                if (!own.tasks.empty())
+                {
+                    out = std::move(own.tasks.back());
+                    own.tasks.pop_back();
+                    m_queued.fetch_sub(1, std::memory_order_relaxed);
+                    return true;
+                }
+            }
+
+            for (std::size_t i = 1; i < m_queues.size(); ++i)
+            {
+                auto& victim = *m_queues[(self + i) % m_queues.size()];
+                std::lock_guard<std::mutex> guard(victim.mutex);
+                if (!victim.tasks.empty())
+                {
+                    out = std::move(victim.tasks.front());
+                    victim.tasks.pop_front();
+                    m_queued.fetch_sub(1, std::memory_order_relaxed);
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        void worker_loop(std::size_t index)
+        {
+            t_pool = this;
+            t_index = index;
+
+            Task task;
+            while (!m_stop.load(std::memory_order_acquire))
+            {
+                if (try_pop(index, task))
+                {
+                    task();
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(m_sleep_mutex);
+                m_wake.wait(lock, [this] {
+                    return m_stop.load(std::memory_order_acquire) || m_queued.load(std::memory_order_acquire) > 0;
+                });
+            }
+        }
+
+        // Queue 0 belongs to threads outside the pool, workers get 1..n
+        std::size_t current_queue() const
+        {
+            return t_pool == this ? t_index : 0;
+        }
+
+    public:
+        explicit ThreadPool(std::size_t workers)
+        {
+            for (std::size_t i = 0; i < workers + 1; ++i)
+                m_queues.push_back(std::make_unique<Queue>());
+
+            for (std::size_t i = 0; i < workers; ++i)
+                m_threads.emplace_back([this, i] { worker_loop(i + 1); });
+        }
+
+        ~ThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> guard(m_sleep_mutex);
+                m_stop.store(true, std::memory_order_release);
+            }
+            m_wake.notify_all();
+            for (auto& t : m_threads) t.join();
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        std::size_t workers() const { return m_threads.size(); }
+
+        template <typename F>
+        void submit(TaskGroup& group, F&& fn)
+        {
+            group.m_pending.fetch_add(1, std::memory_order_relaxed);
+
+            Task task = [&group, fn = std::forward<F>(fn)]() mutable {
+                try
+                {
+                    fn();
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> guard(group.m_error_mutex);
+                    if (!group.m_error) group.m_error = std::current_exception();
+                }
+                group.m_pending.fetch_sub(1, std::memory_order_acq_rel);
+            };
+
+            // Workers keep what they spawn, others spread work round robin
+            auto index = current_queue();
+            if (index == 0 && !m_threads.empty())
+                index = 1 + m_next_queue.fetch_add(1, std::memory_order_relaxed) % m_threads.size();
+
+            {
+                auto& queue = *m_queues[index];
+                std::lock_guard<std::mutex> guard(queue.mutex);
+                queue.tasks.push_back(std::move(task));
+            }
+
+            {
+                std::lock_guard<std::mutex> guard(m_sleep_mutex);
+                m_queued.fetch_add(1, std::memory_order_release);
+            }
+            m_wake.notify_one();
+        }
+
+        void wait(TaskGroup& group)
+        {
+            Task task;
+            while (!group.done())
+            {
+                if (try_pop(current_queue(), task))
+                    task();
+                else
+                    std::this_thread::yield();
+            }
+
+            if (group.m_error)
+            {
+                auto error = group.m_error;
+                group.m_error = nullptr;
+                std::rethrow_exception(error);
+            }
+        }
+
+        // Calls fn(begin, end) over [0, n) split into chunks of `grain`.
+        template <typename F>
+        void parallel_for(std::size_t n, std::size_t grain, F&& fn)
+        {
+            if (grain == 0) grain = 1;
+
+            TaskGroup group;
+            for (std::size_t begin = 0; begin < n; begin += grain)
+            {
+                auto end = std::min(n, begin + grain);
+                submit(group, [&fn, begin, end] { fn(begin, end); });
+            }
+            wait(group);
+        }
+    };
+
+    template <typename... Ts>
+    struct Reads { };
+
+    template <typename... Ts>
+    struct Writes { };
+
+    struct SystemContext
+    {
+        World& world;
+        // nullptr when running in deterministic single thread mode
+        ThreadPool* pool;
+        // Structural changes go here, they are applied once the stage is done
+        CommandBuffer& commands;
+        // Tick of the system's previous run, for View::each_changed
+        Tick last_run;
+    };
+
+    using SystemFn = std::function<void(SystemContext&)>;
+
+    // Runs systems which declare the component types they read and write.
+    // Systems are packed into stages, in registration order, such that no two
+    // systems of a stage conflict; systems of a stage run concurrently on the
+    // pool. Relative order of conflicting systems is always preserved, so the
+    // outcome matches running them one by one. Exclusive systems (touching
+    // anything outside the declared components, e.g. SDL) always run alone on
+    // the calling thread.
+    // Every system records structural changes into its own CommandBuffer;
+    // those are flushed after each stage in registration order, which keeps
+    // the result identical with and without a pool.
+    class Scheduler
+    {
+    private:
+        struct SystemEntry
+        {
+            std::string name;
+            ComponentBitSet reads;
+            ComponentBitSet writes;
+            bool exclusive;
+            SystemFn fn;
+            std::unique_ptr<CommandBuffer> commands;
+            Tick last_run = 0;
+        };
+
+        std::vector<SystemEntry> m_systems;
+        std::vector<std::vector<std::size_t>> m_stages;
+        ThreadPool* m_pool = nullptr;
+
+        template <typename... Ts>
+        static ComponentBitSet mask_of(Reads<Ts...>) { return component_mask<Ts...>(); }
+
+        template <typename... Ts>
+        static ComponentBitSet mask_of(Writes<Ts...>) { return component_mask<Ts...>(); }
+
+        static bool conflicts(const SystemEntry& a, const SystemEntry& b)
+        {
+            if (a.exclusive || b.exclusive) return true;
+            return (a.writes & (b.reads | b.writes)).any() || (b.writes & a.reads).any();
+        }
+
+        void build_stages()
+        {
+            m_stages.clear();
+            for (std::size_t i = 0; i < m_systems.size(); ++i)
+            {
+                // Earliest stage after the last one holding a conflicting system
+                std::size_t stage = 0;
+                for (std::size_t s = m_stages.size(); s > 0; --s)
+                {
+                    bool conflict = false;
+                    for (auto j : m_stages[s - 1]) conflict = conflict || conflicts(m_systems[i], m_systems[j]);
+                    if (conflict)
+                    {
+                        stage = s;
+                        break;
+                    }
+                }
+
+                if (stage == m_stages.size()) m_stages.emplace_back();
+                m_stages[stage].push_back(i);
+            }
+        }
+
+    public:
+        Scheduler() { };
+        ~Scheduler() { };
+
+        void set_pool(ThreadPool* pool) { m_pool = pool; }
+
+        template <typename R = Reads<>, typename W = Writes<>>
+        void add_system(std::string name, SystemFn fn)
+        {
+            m_systems.push_back(SystemEntry { name, mask_of(R {}), mask_of(W {}), false, fn, std::make_unique<CommandBuffer>() });
+            build_stages();
+        }
+
+        void add_exclusive_system(std::string name, SystemFn fn)
+        {
+            m_systems.push_back(SystemEntry { name, {}, {}, true, fn, std::make_unique<CommandBuffer>() });
+            build_stages();
+        }
+
+        std::size_t stages() const { return m_stages.size(); }
+
+        void run(World& world)
+        {
+            for (auto& stage : m_stages)
+            {
+                auto now = advance_tick();
+                auto context = [&](SystemEntry& system, ThreadPool* pool)
+                {
+                    auto since = system.last_run;
+                    system.last_run = now;
+                    return SystemContext { world, pool, *system.commands, since };
+                };
+
+                if (m_pool == nullptr || stage.size() == 1)
+                {
+                    for (auto i : stage)
+                    {
+                        auto& system = m_systems[i];
+                        auto ctx = context(system, system.exclusive ? nullptr : m_pool);
+                        system.fn(ctx);
+                    }
+                }
+                else
+                {
+                    TaskGroup group;
+                    for (auto i : stage)
+                    {
+                        m_pool->submit(group, [this, i, &context] {
+                            auto& system = m_systems[i];
+                            auto ctx = context(system, m_pool);
+                            system.fn(ctx);
+                        });
+                    }
+                    m_pool->wait(group);
+                }
+
+                for (auto i : stage) m_systems[i].commands->flush(world);
+            }
+        }
+    };
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <tuple>
+#include <type_traits>
+
+#include "ecs.hpp"
+
+namespace ecs
+{
+    // Result of World::view<Ts...>(). The set of matching archetypes is cached
+    // by the world between calls, so iterating only costs the entities that
+    // actually hold every requested component. Callbacks get typed references
+    // straight out of the archetype columns:
+    //
+    //     world.view<TransformComponent, SpriteComponent>().each(
+    //         [](TransformComponent& t, SpriteComponent& s) { ... });
+    //
+    // or with the entity handle as first argument.
+    template <typename... Ts>
+    class View
+    {
+    private:
+        World::QueryCache& m_query;
+    public:
+        explicit View(World::QueryCache& query) : m_query { query } { }
+
+        template <typename F>
+        void each(F&& fn)
+        {
+            for (auto archetype : m_query.archetypes)
+            {
+                auto n = archetype->size();
+                if (n == 0) continue;
+
+                auto columns = std::make_tuple(archetype->template column<Ts>().data()...);
+                for (std::size_t row = 0; row < n; ++row)
+                {
+                    std::apply([&](auto*... c)
+                    {
+                        if constexpr (std::is_invocable_v<F, EntityId, Ts&...>)
+                            fn(archetype->entity(row), c[row]...);
+                        else
+                            fn(c[row]...);
+                    }, columns);
+                }
+            }
+        }
+
+        // Like each(), but only visits entities whose C component was changed
+        // after `since`, see Tracked.
+        template <typename C, typename F>
+        void each_changed(Tick since, F&& fn)
+        {
+            static_assert(std::is_base_of_v<Tracked, C>, "Change detection needs a Tracked component");
+
+            each([&](EntityId e, Ts&... components)
+            {
+                if (!std::get<C&>(std::tie(components...)).changed_since(since)) return;
+
+                if constexpr (std::is_invocable_v<F, EntityId, Ts&...>)
+                    fn(e, components...);
+                else
+                    fn(components...);
+            });
+        }
+
+        // Like each(), but splits every matching archetype into chunks of
+        // `grain` rows and runs them on the pool. Chunks never share rows, so
+        // fn may write the components it is given. Falls back to each() when
+        // there is no pool.
+        template <typename F>
+        void par_each(ThreadPool* pool, F&& fn, std::size_t grain = 1024)
+        {
+            if (pool == nullptr)
+            {
+                each(std::forward<F>(fn));
+                return;
+            }
+
+            TaskGroup group;
+            for (auto archetype : m_query.archetypes)
+            {
+                auto n = archetype->size();
+                for (std::size_t begin = 0; begin < n; begin += grain)
+                {
+                    auto end = std::min(n, begin + grain);
+                    pool->submit(group, [archetype, begin, end, &fn]
+                    {
+                        auto columns = std::make_tuple(archetype->template column<Ts>().data()...);
+                        for (std::size_t row = begin; row < end; ++row)
+                        {
+                            std::apply([&](auto*... c)
+                            {
+                                if constexpr (std::is_invocable_v<F, EntityId, Ts&...>)
+                                    fn(archetype->entity(row), c[row]...);
+                                else
+                                    fn(c[row]...);
+                            }, columns);
+                        }
+                    });
+                }
+            }
+            pool->wait(group);
+        }
+
+        std::size_t size() const
+        {
+            std::size_t n = 0;
+            for (auto archetype : m_query.archetypes) n += archetype->size();
+            return n;
+        }
+
+        bool empty() const { return size() == 0; }
+    };
+};
@@ -0,0 +1,482 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <memory_resource>
+#include <utility>
+#include <optional>
+#include <tuple>
+#include <cassert>
+#include <mutex>
+#include <string>
+#include <stdexcept>
+
+#include "ecs.hpp"
+#include "memory.hpp"
+
+namespace ecs
+{
+    // 32 bit entity handle: the low bits index into the world's sparse entity
+    // table, the high bits hold the generation of that slot. Destroying an
+    // entity bumps the slot generation, so stale handles are detected with a
+    // single compare instead of being kept alive by reference counting.
+    class EntityId
+    {
+    public:
+        static constexpr std::uint32_t indexBits = 20;
+        static constexpr std::uint32_t generationBits = 32 - indexBits;
+        static constexpr std::uint32_t indexMask = (1u << indexBits) - 1;
+        static constexpr std::uint32_t generationMask = (1u << generationBits) - 1;
+        static constexpr std::uint32_t maxEntities = indexMask;
+
+    private:
+        std::uint32_t m_value = ~0u;
+    public:
+        constexpr EntityId() { }
+        constexpr explicit EntityId(std::uint32_t index, std::uint32_t generation)
+        : m_value { (index & indexMask) | ((generation & generationMask) << indexBits) }
+        { }
+
+        constexpr std::uint32_t index() const { return m_value & indexMask; }
+        constexpr std::uint32_t generation() const { return m_value >> indexBits; }
+        constexpr std::uint32_t value() const { return m_value; }
+
+        constexpr bool is_null() const { return m_value == ~0u; }
+        constexpr explicit operator bool() const { return !is_null(); }
+
+        constexpr bool operator==(const EntityId& o) const { return m_value == o.m_value; }
+        constexpr bool operator!=(const EntityId& o) const { return m_value != o.m_value; }
+    };
+
+    constexpr EntityId nullEntity {};
+
+    template <typename... Ts>
+    class View;
+
+    // Type erased storage for a single component type inside an archetype.
+    // Rows are kept densely packed, removal is swap-and-pop.
+    class ColumnBase
+    {
+    public:
+        virtual ~ColumnBase() { }
+
+        virtual resource_ptr<ColumnBase> make_empty() const = 0;
+        virtual void move_row_to(std::size_t row, ColumnBase& dst) = 0;
+        virtual void swap_remove(std::size_t row) = 0;
+        virtual void clear() = 0;
+        virtual std::size_t size() const = 0;
+    };
+
+    template <typename T>
+    class Column : public ColumnBase
+    {
+    private:
+        std::pmr::vector<T> m_data;
+    public:
+        explicit Column(std::pmr::memory_resource* resource) : m_data { resource } { }
+
+        resource_ptr<ColumnBase> make_empty() const override
+        {
+            auto resource = m_data.get_allocator().resource();
+            return make_in<Column<T>>(resource, resource);
+        }
+
+        void move_row_to(std::size_t row, ColumnBase& dst) override
+        {
+            static_cast<Column<T>&>(dst).m_data.push_back(std::move(m_data[row]));
+        }
+
+        void swap_remove(std::size_t row) override
+        {
+            if (row != m_data.size() - 1)
+            {
+                m_data[row] = std::move(m_data.back());
+            }
+            m_data.pop_back();
+        }
+
+        void clear() override { m_data.clear(); }
+        std::size_t size() const override { return m_data.size(); }
+
+        std::pmr::vector<T>& data() { return m_data; }
+    };
+
+    // All entities sharing the same component signature. Every component type
+    // in the signature gets its own contiguous column, so walking one component
+    // type across the archetype is a linear scan (structure of arrays). The
+    // columns double as per component type pools: rows are recycled by
+    // swap-and-pop and their capacity survives clear().
+    class Archetype
+    {
+    private:
+        ComponentBitSet m_signature;
+        std::array<resource_ptr<ColumnBase>, maxComponents> m_columns;
+        std::pmr::vector<EntityId> m_entities;
+    public:
+        explicit Archetype(ComponentBitSet signature, std::pmr::memory_resource* resource)
+        : m_signature { signature }, m_entities { resource }
+        { }
+
+        const ComponentBitSet& signature() const { return m_signature; }
+        std::size_t size() const { return m_entities.size(); }
+        EntityId entity(std::size_t row) const { return m_entities[row]; }
+
+        bool has_column(ComponentTypeID id) const { return m_columns[id] != nullptr; }
+        ColumnBase& column(ComponentTypeID id) { return *m_columns[id]; }
+        void set_column(ComponentTypeID id, resource_ptr<ColumnBase> c) { m_columns[id] = std::move(c); }
+
+        template <typename T>
+        std::pmr::vector<T>& column()
+        {
+            return static_cast<Column<T>&>(*m_columns[get_component_type_id<T>()]).data();
+        }
+
+        std::size_t push_entity(EntityId e)
+        {
+            m_entities.push_back(e);
+            return m_entities.size() - 1;
+        }
+
+        // Removes the row by moving the last row into its place.
+        // Returns the entity which now lives at `row`, if any moved.
+        std::optional<EntityId> swap_remove(std::size_t row)
+        {
+            for (auto& c : m_columns) if (c) c->swap_remove(row);
+
+            std::optional<EntityId> moved;
+            if (row != m_entities.size() - 1)
+            {
+                m_entities[row] = m_entities.back();
+                moved = m_entities[row];
+            }
+            m_entities.pop_back();
+            return moved;
+        }
+
+        void clear()
+        {
+            for (auto& c : m_columns) if (c) c->clear();
+            m_entities.clear();
+        }
+    };
+
+    // Archetype based entity store. Components are plain values grouped by
+    // signature instead of being heap allocated one by one per entity.
+    // Entities are looked up through a sparse table indexed by the handle
+    // index, which points at the dense archetype row, so lookups are O(1) and
+    // destroying is a swap-and-pop.
+    // References returned by add_component/get_component are only valid until
+    // the next structural change (adding/removing components, create, destroy).
+    // All storage comes from the memory resource given at construction, e.g.
+    // an Arena for level scoped entities.
+    class World
+    {
+    private:
+        struct EntityRecord
+        {
+            Archetype* archetype = nullptr;
+            std::size_t row = 0;
+            std::uint32_t generation = 0;
+        };
+
+        // Archetypes matching a query mask. Archetypes are never removed, so
+        // refreshing only has to look at the ones created since the last run.
+        struct QueryCache
+        {
+            ComponentBitSet mask;
+            std::pmr::vector<Archetype*> archetypes;
+            std::size_t seen = 0;
+
+            QueryCache(ComponentBitSet m, std::pmr::memory_resource* resource) : mask { m }, archetypes { resource } { }
+        };
+
+        std::pmr::memory_resource* m_resource;
+        std::pmr::vector<resource_ptr<Archetype>> m_archetypes;
+        std::pmr::unordered_map<ComponentBitSet, Archetype*> m_archetype_index;
+        std::pmr::unordered_map<ComponentBitSet, resource_ptr<QueryCache>> m_queries;
+        std::mutex m_queries_mutex;
+        std::pmr::vector<EntityRecord> m_records;
+        std::pmr::vector<std::uint32_t> m_free_indices;
+
+        Archetype* find_archetype(ComponentBitSet signature) const
+        {
+            auto it = m_archetype_index.find(signature);
+            return it != m_archetype_index.end() ? it->second : nullptr;
+        }
+
+        // Columns are cloned from `like`, except `extra_id` which takes `extra`
+        Archetype* create_archetype(ComponentBitSet signature, Archetype* like, ComponentTypeID extra_id, resource_ptr<ColumnBase> extra)
+        {
+            auto archetype = make_in<Archetype>(m_resource, signature, m_resource);
+            for (ComponentTypeID id = 0; id < maxComponents; ++id)
+            {
+                if (!signature.test(id)) continue;
+
+                if (id == extra_id)
+                    archetype->set_column(id, std::move(extra));
+                else
+                    archetype->set_column(id, like->column(id).make_empty());
+            }
+
+            auto ptr = archetype.get();
+            m_archetypes.push_back(std::move(archetype));
+            m_archetype_index[signature] = ptr;
+            return ptr;
+        }
+
+        Archetype* empty_archetype()
+        {
+            auto archetype = find_archetype(ComponentBitSet {});
+            return archetype ? archetype : create_archetype(ComponentBitSet {}, nullptr, maxComponents, nullptr);
+        }
+
+        EntityRecord& record(EntityId e)
+        {
+            assert(is_alive(e));
+            return m_records[e.index()];
+        }
+
+        const EntityRecord& record(EntityId e) const
+        {
+            assert(is_alive(e));
+            return m_records[e.index()];
+        }
+
+        void remove_row(Archetype* archetype, std::size_t row)
+        {
+            auto moved = archetype->swap_remove(row);
+            if (moved) m_records[moved->index()].row = row;
+        }
+
+        void release(std::uint32_t index)
+        {
+            auto& r = m_records[index];
+            r.archetype = nullptr;
+            r.generation = (r.generation + 1) & EntityId::generationMask;
+            m_free_indices.push_back(index);
+        }
+
+        // Moves an entity to a new archetype, carrying over all components
+        // both archetypes have in common.
+        void migrate(EntityId e, Archetype* dst)
+        {
+            auto& r = record(e);
+            auto src = r.archetype;
+
+            for (ComponentTypeID id = 0; id < maxComponents; ++id)
+            {
+                if (src->has_column(id) && dst->has_column(id))
+                    src->column(id).move_row_to(r.row, dst->column(id));
+            }
+
+            auto row = r.row;
+            auto new_row = dst->push_entity(e);
+            remove_row(src, row);
+
+            r.archetype = dst;
+            r.row = new_row;
+        }
+        // Systems running in parallel may ask for views at the same time
+        QueryCache& query(ComponentBitSet mask)
+        {
+            std::lock_guard<std::mutex> guard(m_queries_mutex);
+            auto& q = m_queries[mask];
+            if (!q) q = make_in<QueryCache>(m_resource, mask, m_resource);
+
+            for (; q->seen < m_archetypes.size(); ++q->seen)
+            {
+                auto archetype = m_archetypes[q->seen].get();
+                if ((archetype->signature() & mask) == mask) q->archetypes.push_back(archetype);
+            }
+
+            return *q;
+        }
+
+        template <typename... Ts>
+        friend class View;
+    public:
+        explicit World(std::pmr::memory_resource* resource = heap())
+        : m_resource { resource },
+          m_archetypes { resource },
+          m_archetype_index { resource },
+          m_queries { resource },
+          m_records { resource },
+          m_free_indices { resource }
+        { };
+        ~World() { };
+
+        World(const World&) = delete;
+        World& operator=(const World&) = delete;
+
+        EntityId create()
+        {
+            std::uint32_t index;
+            if (!m_free_indices.empty())
+            {
+                index = m_free_indices.back();
+                m_free_indices.pop_back();
+            }
+            else
+            {
+                if (m_records.size() >= EntityId::maxEntities)
+                    throw std::runtime_error("World ran out of entity indices");
+
+                index = static_cast<std::uint32_t>(m_records.size());
+                m_records.emplace_back();
+            }
+
+            auto& r = m_records[index];
+            EntityId e { index, r.generation };
+            r.archetype = empty_archetype();
+            r.row = r.archetype->push_entity(e);
+            return e;
+        }
+
+        bool is_alive(EntityId e) const
+        {
+            if (e.index() >= m_records.size()) return false;
+            auto& r = m_records[e.index()];
+            return r.archetype != nullptr && r.generation == e.generation();
+        }
+
+        void destroy(EntityId e)
+        {
+            auto& r = record(e);
+            remove_row(r.archetype, r.row);
+            release(e.index());
+        }
+
+        void clear()
+        {
+            for (auto& a : m_archetypes) a->clear();
+            for (std::uint32_t i = 0; i < m_records.size(); ++i)
+                if (m_records[i].archetype) release(i);
+        }
+
+        std::size_t size() const
+        {
+            return m_records.size() - m_free_indices.size();
+        }
+
+        template <typename T>
+        bool has_component(EntityId e) const
+        {
+            return record(e).archetype->signature().test(get_component_type_id<T>());
+        }
+
+        // Creates an entity holding all of the given components, placed
+        // straight into its final archetype. Missing component dependencies
+        // (see requirements_of) are a compile error here.
+        template <typename... Ts>
+        EntityId spawn(Ts&&... components)
+        {
+            using List = TypeList<std::decay_t<Ts>...>;
+            static_assert((requirements_met<std::decay_t<Ts>, List>::value && ...),
+                    "Spawned entity is missing a component required by another one");
+
+            auto signature = component_mask<std::decay_t<Ts>...>();
+            Archetype* archetype = find_archetype(signature);
+            if (!archetype)
+            {
+                auto a = make_in<Archetype>(m_resource, signature, m_resource);
+                (a->set_column(get_component_type_id<std::decay_t<Ts>>(), make_in<Column<std::decay_t<Ts>>>(m_resource, m_resource)), ...);
+                archetype = a.get();
+                m_archetypes.push_back(std::move(a));
+                m_archetype_index[signature] = archetype;
+            }
+
+            auto e = create();
+            migrate(e, archetype);
+            (archetype->column<std::decay_t<Ts>>().push_back(std::forward<Ts>(components)), ...);
+            return e;
+        }
+
+        // Attaching a component before the ones it requires throws, spawn()
+        // catches the same mistake at compile time.
+        template <typename T, typename... TArgs>
+        T& add_component(EntityId e, TArgs&&... mArgs)
+        {
+            auto id = get_component_type_id<T>();
+            auto src = record(e).archetype;
+            T* component;
+
+            auto required = component_mask(typename requirements_of<T>::type {});
+            if ((src->signature() & required) != required)
+            {
+                throw std::runtime_error("Entity is missing a component required by the one being added");
+            }
+
+            if (src->signature().test(id))
+            {
+                component = &src->column<T>()[record(e).row];
+                *component = T(std::forward<TArgs>(mArgs)...);
+            }
+            else
+            {
+                auto signature = src->signature();
+                signature.set(id);
+                auto dst = find_archetype(signature);
+                if (!dst) dst = create_archetype(signature, src, id, make_in<Column<T>>(m_resource, m_resource));
+
+                // Construct first so a throwing constructor leaves the entity untouched
+                T c(std::forward<TArgs>(mArgs)...);
+                migrate(e, dst);
+
+                auto& components = dst->column<T>();
+                components.push_back(std::move(c));
+                component = &components.back();
+            }
+
+            return *component;
+        }
+
+        template <typename T>
+        void remove_component(EntityId e)
+        {
+            auto id = get_component_type_id<T>();
+            auto src = record(e).archetype;
+            if (!src->signature().test(id)) return;
+
+            auto signature = src->signature();
+            signature.reset(id);
+            auto dst = find_archetype(signature);
+            if (!dst) dst = create_archetype(signature, src, maxComponents, nullptr);
+            migrate(e, dst);
+        }
+
+        // Unchecked access for entities known to hold T
+        template <typename T>
+        T& get(EntityId e)
+        {
+            auto& r = record(e);
+            assert(r.archetype->signature().test(get_component_type_id<T>()));
+            return r.archetype->column<T>()[r.row];
+        }
+
+        // Returns nullptr for stale handles or missing components.
+        template <typename T>
+        T* get_component(EntityId e)
+        {
+            if (!is_alive(e)) return nullptr;
+            auto& r = m_records[e.index()];
+            if (!r.archetype->signature().test(get_component_type_id<T>())) return nullptr;
+            return &r.archetype->column<T>()[r.row];
+        }
+
+        // Typed query over every entity holding all of Ts.
+        template <typename... Ts>
+        View<Ts...> view()
+        {
+            return View<Ts...> { query(component_mask<Ts...>()) };
+        }
+
+        template <typename... Ts, typename F>
+        void each(F&& fn)
+        {
+            view<Ts...>().each(std::forward<F>(fn));
+        }
+    };
+};
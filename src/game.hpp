@@ -1,11 +1,20 @@
 #pragma once
 
+#include <filesystem>
+#include <future>
+
 #include "logging.hpp"
+#include "heap.hpp"
 #include "geometry.hpp"
 #include "sdl/sdl.hpp"
 #include "ecs/ecs.hpp"
 #include "components/components.hpp"
 #include "map/map.hpp"
+#include "map/fov.hpp"
+#include "map/level.hpp"
+#include "map/pathfinding.hpp"
+#include "map/spatial_grid.hpp"
+#include "map/tile_layer.hpp"
 
 using namespace ecs;
 using namespace ecs::components;
@@ -17,6 +26,10 @@ private:
     int m_difficulty = 0;
     int m_sprite_size = 32;
     int m_light_radius = 15;
+    int m_enemy_light_radius = 4;
+    LightColor m_enemy_light { 60, 110, 255 };
+    // Enemies further than this many steps from the player stay put
+    int m_enemy_chase_distance = 20;
     int m_screen_width;
     int m_screen_height;
     int m_playfield_width;
@@ -24,19 +37,53 @@ private:
     int m_map_width;
     int m_map_height;
     std::shared_ptr<sdl::Window> m_window;
-    System m_system;
-    std::shared_ptr<Group> m_tiles_group;
-    std::shared_ptr<Group> m_player_group;
-    std::shared_ptr<Group> m_enemies_group;
-    std::shared_ptr<Group> m_darkness_group;
-
-    std::shared_ptr<Entity> player;
-    std::shared_ptr<Entity> offset;
-    std::shared_ptr<Entity> darkness;
+    World m_world;
+    // Enemies live and die with the level, their world is carved out of the
+    // level arena and thrown away in one go on descent
+    Arena m_level_arena { 256 << 10 };
+    std::optional<World> m_level_world;
+    std::unique_ptr<ThreadPool> m_pool;
+    Scheduler m_update_systems;
+
+    EntityId player;
+    EntityId offset;
+    EntityId darkness;
 
     std::unique_ptr<sdl::SpriteManager> m_sprite_manager;
+    // The level is an unbounded world streamed in chunks around the player.
+    // m_level is the window of it starting at world cell m_window_origin,
+    // everything else (FOV, lighting, pathing, entities) works in window
+    // coordinates.
+    std::unique_ptr<ChunkedMap> m_world_map;
+    Vector2D m_window_origin { 0, 0 };
     std::unique_ptr<Map> m_level;
-    std::unique_ptr<LightMap> m_light_map;
+    // Enemies kept around the player, topped up as the window moves
+    std::size_t m_level_enemies = 0;
+    // The player is in another chunk than the window's middle one, but the
+    // chunks of the next window were still loading
+    bool m_window_behind = false;
+    // The level below, generated on a worker thread while this one is played
+    std::future<Level> m_next_level;
+    std::unique_ptr<Fov> m_fov { std::make_unique<ShadowcastingFov>() };
+    // Every level picks one of these
+    std::vector<std::unique_ptr<Generator>> m_generators;
+    std::unique_ptr<TileLayer> m_tile_layer;
+    // Sprites of a frame, drawn grouped by texture
+    sdl::SpriteBatch m_batch;
+    // Steps to the player, shared by every chasing enemy
+    DijkstraMap m_player_distance;
+    // Enemies in sight of the player but beyond the chase distance walk
+    // its path, one query each
+    Pathfinder m_pathfinder;
+    std::vector<Vector2D> m_path;
+    BitGrid m_occupied;
+    // Drawable entities of the level world by position, so drawing only
+    // visits the ones on screen
+    SpatialGrid<EntityId> m_level_sprites;
+    // ECS and, in debug builds, all heap allocations of the last frame,
+    // only changes get logged
+    std::size_t m_frame_allocations = 0;
+    std::size_t m_frame_heap_allocations = 0;
 
 public:
     Game(int screen_width, int screen_height) :
@@ -44,81 +91,88 @@ public:
         m_screen_height { screen_height },
         m_playfield_width { m_screen_width / m_sprite_size },
         m_playfield_height { m_screen_height / m_sprite_size },
-        m_map_width { 100 },
-        m_map_height { 100 },
+        m_map_width { window_size(m_playfield_width) },
+        m_map_height { window_size(m_playfield_height) },
         m_window { std::make_shared<sdl::Window>(screen_width, screen_height) },
         m_sprite_manager { std::make_unique<sdl::SpriteManager>(m_window) }
     { };
 
-    void add_map()
+    ~Game()
     {
-        auto wall_sprite = m_sprite_manager->get_sprite("sprites/surroundings.png");
-        logger::info("Loading levels sprite");
-        m_level = std::make_unique<Map>(m_map_width, m_map_height);
+        drop_world_map();
+        if (m_next_level.valid())
+        {
+            m_world_map = std::move(m_next_level.get().world);
+            drop_world_map();
+        }
     }
 
     void add_darkness()
     {
-        darkness = m_darkness_group->add_entity();
-
         auto darkness_sprite = m_sprite_manager->get_sprite("sprites/darkness.png");
         darkness_sprite->set_blend_mode(SDL_BLENDMODE_BLEND);
 
-        darkness->add_component<TransformComponent>(Vector2D { 0, 0 });
-        darkness->add_component<MovementComponent>();
-        darkness->add_component<SpriteComponent>(m_window, darkness_sprite);
-        darkness->add_component<DarknessComponent>(m_map_width, m_map_height, get_visible_fn(), get_memoized_fn(), offset);
+        darkness = m_world.spawn(
+                TransformComponent { Vector2D { 0, 0 } },
+                MovementComponent {},
+                SpriteComponent { m_window, darkness_sprite },
+                DarknessComponent { m_map_width, m_map_height, get_visible_fn(), get_memoized_fn(), get_light_fn(),
+                    [this]() { return m_level->shade_revision(); } });
     }
 
     void init()
     {
         m_window->set_resizable(false);
+        init_systems();
+
+        m_generators.push_back(std::make_unique<RoomsGenerator>());
+        m_generators.push_back(std::make_unique<BspGenerator>());
+        m_generators.push_back(std::make_unique<CaveGenerator>());
+        m_generators.push_back(std::make_unique<DrunkardGenerator>());
         m_window->open_font("ttf/terminus.ttf", 24);
 
-        m_sprite_manager->preload_sprite("sprites/surroundings.png", 1, 3, m_sprite_size, m_sprite_size);
+        // Tiles and the mage were always drawn mirrored, that is done once
+        // while packing now
+        m_sprite_manager->preload_sprite("sprites/surroundings.png", 1, 3, m_sprite_size, m_sprite_size, true);
         m_sprite_manager->preload_sprite("sprites/darkness.png", 1, 1, m_sprite_size, m_sprite_size);
-        m_sprite_manager->preload_sprite("sprites/mage.png", 1, 1, m_sprite_size, m_sprite_size, sdl::RGB { 0xFF, 0, 0xFF });
+        m_sprite_manager->preload_sprite("sprites/mage.png", 1, 1, m_sprite_size, m_sprite_size, sdl::RGB { 0xFF, 0, 0xFF }, true);
 
-        m_tiles_group = m_system.add_group();
-        m_player_group = m_system.add_group();
-        player = m_player_group->add_entity();
-        offset = m_player_group->add_entity();
 
-        add_map();
-        generate_tiles();
+        m_tile_layer = std::make_unique<TileLayer>(m_window, m_sprite_manager->get_sprite("sprites/surroundings.png"));
 
         auto player_sprite = m_sprite_manager->get_sprite("sprites/mage.png");
 
-        player->add_component<SpriteComponent>(m_window, player_sprite);
-        player->add_component<SpriteRenderComponent>([](int x, int y){ return true; }, offset);
-        player->add_component<TransformComponent>(Vector2D { 0, 0 });
-        player->add_component<MovementComponent>();
-
-        offset->add_component<TransformComponent>(Vector2D { 0, 0 });
-        offset->add_component<OffsetComponent>(Vector2D { m_playfield_width, m_playfield_height }, Vector2D { m_map_width, m_map_height }, player);
-
-        auto pos = m_level->get_random_empty_coords();
-        set_centered_player_pos(pos);
+        player = m_world.spawn(
+                SpriteComponent { m_window, player_sprite },
+                SpriteRenderComponent { [](int x, int y){ return true; } },
+                TransformComponent { Vector2D { 0, 0 } },
+                MovementComponent {},
+                LightComponent { m_light_radius, LightColor { 255, 210, 150 } });
 
-        regen_light_map();
+        offset = m_world.spawn(
+                TransformComponent { Vector2D { 0, 0 } },
+                OffsetComponent { Vector2D { m_playfield_width, m_playfield_height }, Vector2D { m_map_width, m_map_height }, player });
 
-        m_enemies_group = m_system.add_group();
-        init_enemies();
+        enter_level(generate_level(level_spec(), rng::gen_seed(rng::Stream::Map), *m_fov));
+        pregenerate_level();
 
-        m_darkness_group = m_system.add_group();
         add_darkness();
 
-        auto text = m_darkness_group->add_entity();
-        text->add_component<TransformComponent>(Vector2D { 0, 0 });
-        text->add_component<TextComponent>(m_window, [this]() { return this->log_debug_info(); }, sdl::RGB { 255, 0, 0 });
-        text->add_component<TextRenderComponent>();
+        m_world.spawn(
+                TransformComponent { Vector2D { 0, 0 } },
+                TextComponent { m_window, [this]() { return this->log_debug_info(); }, sdl::RGB { 255, 0, 0 } },
+                TextRenderComponent {});
+
+        update();
     }
 
     std::string log_debug_info()
     {
-        auto ppos = get_real_player_pos();
-        auto offpos = offset->get_component<TransformComponent>()->get_pos();
-        return "player pos is " + ppos.to_string() + " offset is " + offpos.to_string();
+        auto ppos = m_window_origin + get_real_player_pos();
+        auto offpos = m_world.get<TransformComponent>(offset).get_pos();
+        auto explored = static_cast<int>(m_level->memoized_ratio() * 100);
+        return "player pos is " + ppos.to_string() + " offset is " + offpos.to_string() + " explored " + std::to_string(explored) + "%"
+            + " chunks " + std::to_string(m_world_map->resident_count());
     }
 
     VisibleLambda get_visible_fn()
@@ -129,6 +183,13 @@ public:
         };
     }
 
+    LightLambda get_light_fn() {
+        return [this](int x, int y)
+        {
+            return m_level->lighting().intensity(x, y);
+        };
+    }
+
     MemoizedLambda get_memoized_fn() {
         return [this](int x, int y)
         {
@@ -136,25 +197,174 @@ public:
         };
     }
 
-    void init_enemies()
+    LevelSpec level_spec()
     {
-        auto player_sprite = m_sprite_manager->get_sprite("sprites/mage.png");
+        return LevelSpec {
+            m_map_width,
+            m_map_height,
+            rng::stream(rng::Stream::Spawn).gen_int(4, 11) + m_difficulty,
+            m_light_radius,
+            m_enemy_light_radius,
+            m_enemy_light,
+            m_generators[rng::stream(rng::Stream::Map).gen_int(0, static_cast<int>(m_generators.size()))].get(),
+        };
+    }
+
+    // Starts building the next level in the background
+    void pregenerate_level()
+    {
+        m_next_level = std::async(std::launch::async,
+                [spec = level_spec(), seed = rng::gen_seed(rng::Stream::Map), fov = m_fov.get()]()
+                {
+                    return generate_level(spec, seed, *fov);
+                });
+    }
+
+    void enter_level(Level level)
+    {
+        drop_world_map();
+        m_world_map = std::move(level.world);
+        m_window_origin = level.origin;
+        m_level_enemies = level.enemies.size();
+        m_level = std::move(level.map);
+        m_tile_layer->invalidate();
+        invalidate_darkness();
+        m_player_distance.resize(m_level->get_w(), m_level->get_h());
+        m_pathfinder.resize(m_level->get_w(), m_level->get_h());
+        m_occupied = BitGrid { m_level->get_w(), m_level->get_h() };
+
+        // Its light was registered with the previous level
+        m_world.get<LightComponent>(player).detach();
+        set_centered_player_pos(level.start);
+        regen_light_map();
+
+        reset_level_world();
+        m_level_sprites = SpatialGrid<EntityId> { m_level->get_w(), m_level->get_h() };
+
+        for (auto& enemy : level.enemies) {
+            spawn_enemy(enemy.pos, LightComponent { m_enemy_light_radius, m_enemy_light, enemy.light });
+        }
+    }
+
+    void spawn_enemy(Vector2D pos, LightComponent light)
+    {
+        auto e = m_level_world->spawn(
+                TransformComponent { pos },
+                MovementComponent {},
+                SpriteComponent { m_window, m_sprite_manager->get_sprite("sprites/mage.png") },
+                SpriteRenderComponent { get_visible_fn() },
+                std::move(light));
+        m_level_sprites.insert(e, pos);
+    }
+
+    // Its pages are only good for this run, nothing is paged out
+    void drop_world_map()
+    {
+        if (!m_world_map) return;
+
+        auto pages = m_world_map->page_dir();
+        m_world_map->discard();
+        m_world_map.reset();
+        std::error_code error;
+        std::filesystem::remove_all(pages, error);
+    }
+
+    // Keeps the window centred on the player's chunk. Crossing into another
+    // chunk moves it by whole chunks: explored cells go back to the world,
+    // the new window is cut out of it and the level's entities are shifted
+    // into its coordinates. Enemies left outside are dropped, new ones
+    // spawn off screen. Returns whether the window moved.
+    // The resident radius reaches a chunk past the window, so the next
+    // window is normally loaded already. If not, the move is retried every
+    // frame (see loop) and the loader only gets waited for when the player
+    // stands on the window's edge.
+    bool follow_player()
+    {
+        auto world_pos = m_window_origin + get_real_player_pos();
+        m_world_map->focus(world_pos);
+
+        auto origin = window_origin(world_pos, m_map_width, m_map_height);
+        m_window_behind = false;
+        if (origin == m_window_origin) return false;
+
+        Rect region;
+        region.x0 = origin.x;
+        region.y0 = origin.y;
+        region.x1 = origin.x + m_map_width;
+        region.y1 = origin.y + m_map_height;
+        if (!m_world_map->resident(region))
+        {
+            auto pos = get_real_player_pos();
+            if (pos.x > 0 && pos.y > 0 && pos.x < m_map_width - 1 && pos.y < m_map_height - 1)
+            {
+                m_window_behind = true;
+                return false;
+            }
+            logger::info("Waiting for chunks around", world_pos.x, world_pos.y);
+            m_world_map->wait();
+        }
 
-        int n = rng::gen_int(4, 11) + m_difficulty;
-        for (int i = 0; i < n; ++i) {
-            auto enemy = m_enemies_group->add_entity();
-            auto pos =  m_level->get_random_empty_coords();
+        store_window(*m_world_map, m_window_origin, *m_level);
 
-            enemy->add_component<TransformComponent>(pos);
-            enemy->add_component<MovementComponent>();
-            enemy->add_component<SpriteComponent>(m_window, player_sprite);
-            enemy->add_component<SpriteRenderComponent>(get_visible_fn(), offset);
+        auto shift = m_window_origin - origin;
+        m_window_origin = origin;
+        m_level = load_window(*m_world_map, origin, m_map_width, m_map_height, rng::gen_seed(rng::Stream::Spawn));
+        m_tile_layer->invalidate();
+        invalidate_darkness();
+
+        // Lights were registered with the previous window's Lighting
+        m_world.get<LightComponent>(player).detach();
+        set_centered_player_pos(get_real_player_pos() + shift);
+
+        std::vector<EntityId> gone;
+        m_level_sprites.clear();
+        m_level_world->view<TransformComponent, LightComponent>().each(
+                [&](EntityId e, TransformComponent& transform, LightComponent& light)
+                {
+                    auto pos = transform.get_pos() + shift;
+                    if (pos.x < 0 || pos.y < 0 || pos.x >= m_map_width || pos.y >= m_map_height)
+                    {
+                        gone.push_back(e);
+                        return;
+                    }
+                    transform.set_pos(pos);
+                    light.detach();
+                    m_level_sprites.insert(e, pos);
+                });
+        for (auto e : gone)
+        {
+            m_level_world->destroy(e);
+        }
+
+        spawn_enemies_off_screen(m_level_enemies - std::min(m_level_enemies, m_level_world->size()));
+        return true;
+    }
+
+    // On empty cells the player can not see yet, a few tries per enemy
+    void spawn_enemies_off_screen(std::size_t count)
+    {
+        auto camera = m_world.get<OffsetComponent>(offset).camera();
+        mark_occupied();
+
+        for (std::size_t tries = 0; count > 0 && tries < count * 8; ++tries)
+        {
+            auto pos = m_level->get_random_empty_coords();
+            if (camera.contains(pos) || m_occupied.test(pos.x, pos.y)) continue;
+
+            spawn_enemy(pos, LightComponent { m_enemy_light_radius, m_enemy_light });
+            m_occupied.set(pos.x, pos.y);
+            --count;
         }
     }
 
+    void invalidate_darkness()
+    {
+        m_world.view<DarknessComponent>().each([](DarknessComponent& darkness) { darkness.invalidate(); });
+    }
+
     void quit()
     {
-        exit(0);
+        m_is_running = false;
     }
 
     void attempt_to_go_next_level()
@@ -162,16 +372,12 @@ public:
         auto pos = get_real_player_pos();
         if (can_go_downstairs(pos))
         {
-            go_down_level();
-
-            m_tiles_group->destroy_all();
-            m_enemies_group->destroy_all();
-            m_system.collect_garbage();
+            // Only blocks if the player found the stairs before the
+            // worker finished
+            enter_level(m_next_level.get());
+            pregenerate_level();
 
-            generate_tiles();
-            init_enemies();
-
-            m_system.update();
+            update();
         }
     }
 
@@ -241,21 +447,75 @@ public:
                 break; // SDL_KEYUP
         }
 
-        move(direction);
-        regen_light_map();
-        m_system.update();
+        // Key ups, blocked moves and unhandled keys change nothing, update()
+        // is close to free then since systems only look at changed entities
+        if (move(direction))
+        {
+            follow_player();
+            regen_light_map();
+            move_enemies();
+        }
+        update();
 
         direction = MovementDirection::None;
     }
 
-    void move(MovementDirection direction)
+    bool move(MovementDirection direction)
     {
         auto pos = get_real_player_pos();
 
-        if (can_move(pos, direction))
+        if (direction == MovementDirection::None || !can_move(pos, direction))
         {
-            player->get_component<MovementComponent>()->move(direction);
+            return false;
         }
+
+        m_world.get<MovementComponent>(player).move(m_world.get<TransformComponent>(player), direction);
+        return true;
+    }
+
+    // Enemies near the player, or seeing them from further away, take one
+    // step toward them, never onto the player or another enemy
+    void move_enemies()
+    {
+        auto ppos = get_real_player_pos();
+        m_player_distance.compute(m_level->tiles(), ppos, m_enemy_chase_distance);
+        mark_occupied();
+
+        auto enemies = m_level_world->view<TransformComponent, MovementComponent>();
+        enemies.each([this, ppos](EntityId e, TransformComponent& transform, MovementComponent& movement)
+                {
+                    auto pos = transform.get_pos();
+                    auto direction = m_player_distance.step(pos, &m_occupied);
+                    // Sight is symmetric, the player seeing it means it sees the player
+                    if (direction == MovementDirection::None
+                            && m_player_distance.distance(pos.x, pos.y) == DijkstraMap::unreachable
+                            && visible(pos.x, pos.y)
+                            && m_pathfinder.find_path(m_level->tiles(), pos, ppos, m_path)
+                            && !m_path.empty() && !m_occupied.test(m_path.front().x, m_path.front().y))
+                    {
+                        direction = direction_to(pos, m_path.front());
+                    }
+                    if (direction == MovementDirection::None) return;
+
+                    m_occupied.reset(pos.x, pos.y);
+                    movement.move(transform, direction);
+                    m_occupied.set(transform.get_x(), transform.get_y());
+                    m_level_sprites.move(e, pos, transform.get_pos());
+                });
+    }
+
+    // Cells of the player and of every enemy
+    void mark_occupied()
+    {
+        m_occupied.clear();
+        auto ppos = get_real_player_pos();
+        m_occupied.set(ppos.x, ppos.y);
+
+        m_level_world->view<TransformComponent, MovementComponent>().each(
+                [this](TransformComponent& transform, MovementComponent&)
+                {
+                    m_occupied.set(transform.get_x(), transform.get_y());
+                });
     }
 
     void loop()
@@ -264,11 +524,15 @@ public:
         SDL_StartTextInput();
         while(m_is_running)
         {
-            m_system.collect_garbage();
+            auto allocations = ecs::allocation_stats().allocations.load();
+#ifndef NDEBUG
+            auto heap_allocations = heap::allocations().load();
+#endif
+
             m_window->reset_viewport();
             m_window->clear();
 
-            m_system.draw();
+            draw();
             m_window->update();
 
             while (SDL_PollEvent(&event) != 0)
@@ -282,10 +546,37 @@ public:
                     case SDL_QUIT:
                         quit();
                         break;
+                    case SDL_RENDER_TARGETS_RESET:
+                    case SDL_RENDER_DEVICE_RESET:
+                        m_tile_layer->invalidate();
+                        m_world.view<DarknessComponent>().each([](DarknessComponent& darkness) { darkness.release_texture(); });
+                        break;
                     default:
                         break;
                 }
             }
+
+            // Chunks of the next window finished loading
+            if (m_window_behind && follow_player())
+            {
+                regen_light_map();
+                update();
+            }
+
+            auto frame_allocations = ecs::allocation_stats().allocations.load() - allocations;
+            if (frame_allocations != m_frame_allocations)
+            {
+                logger::info("ECS heap allocations per frame:", frame_allocations);
+                m_frame_allocations = frame_allocations;
+            }
+#ifndef NDEBUG
+            auto frame_heap_allocations = heap::allocations().load() - heap_allocations;
+            if (frame_heap_allocations != m_frame_heap_allocations)
+            {
+                logger::info("Heap allocations per frame:", frame_heap_allocations);
+                m_frame_heap_allocations = frame_heap_allocations;
+            }
+#endif
         }
     }
 
@@ -293,19 +584,19 @@ public:
 
     Vector2D get_real_player_pos()
     {
-        return player->get_component<TransformComponent>()->get_pos();
+        return m_world.get<TransformComponent>(player).get_pos();
     }
 
     void set_centered_player_pos(Vector2D pos)
     {
         set_player_pos(pos);
-        offset->get_component<OffsetComponent>()->update();
+        update_offset();
     }
 
     void set_player_pos(Vector2D pos)
     {
         logger::info("Setting player at (x, y)", pos.x, pos.y);
-        player->get_component<TransformComponent>()->set_pos(pos);
+        m_world.get<TransformComponent>(player).set_pos(pos);
     }
 
     bool can_move(Vector2D pos, MovementDirection direction) const
@@ -318,16 +609,12 @@ public:
         return m_level->at(pos.x, pos.y) == TileType::StairsDown;
     }
 
-    bool visible(int x, int y)
+    bool visible(int x, int y) const
     {
-        bool vis = m_light_map->visible(x, y);
-
-        if (vis) { m_level->memoize(x, y); }
-
-        return vis;
+        return m_level->light().visible(x, y);
     }
 
-    bool memoized(int x, int y)
+    bool memoized(int x, int y) const
     {
         return m_level->memoized(x, y);
     }
@@ -335,48 +622,122 @@ public:
     void regen_light_map()
     {
         auto pos = get_real_player_pos();
-        m_light_map = m_level->generate_light_map(pos, m_light_radius);
+        m_level->update_light(*m_fov, pos, m_light_radius);
     }
 
-    void go_down_level()
+    void reset_level_world()
     {
-        add_map();
-        auto pos = m_level->get_random_empty_coords();
-        set_centered_player_pos(pos);
-        regen_light_map();
+        m_level_world.reset();
+        m_level_arena.reset();
+        m_level_world.emplace(&m_level_arena);
     }
 
-    void generate_tiles()
+    // SYSTEMS
+
+    void init_systems()
     {
-        auto sprite = m_sprite_manager->get_sprite("sprites/surroundings.png");
+        auto hw = std::thread::hardware_concurrency();
+        m_pool = std::make_unique<ThreadPool>(hw > 1 ? hw - 1 : 0);
+        m_update_systems.set_pool(m_pool.get());
 
-        int sprite_col;
-        for (int x = 0; x < m_level->get_w(); ++x)
-        {
-            for (int y = 0; y < m_level->get_h(); ++y)
-            {
-                auto tile = m_level->at(x, y);
-                auto entity = m_tiles_group->add_entity();
+        m_update_systems.add_system<Reads<TransformComponent>, Writes<TransformComponent, OffsetComponent>>(
+                "offset",
+                [](SystemContext& ctx)
+                {
+                    ctx.world.view<TransformComponent, OffsetComponent>().each(
+                            [&](TransformComponent& transform, OffsetComponent& offset)
+                            {
+                                offset.update(ctx.world, transform, ctx.last_run);
+                            });
+                });
+
+        // Lights of the player and of the level's enemies feed the level's
+        // Lighting, which lives outside the ECS
+        m_update_systems.add_exclusive_system(
+                "lights",
+                [this](SystemContext& ctx)
+                {
+                    auto& lighting = m_level->lighting();
+                    auto sync = [&](TransformComponent& transform, LightComponent& light)
+                    {
+                        light.sync(lighting, transform, ctx.last_run);
+                    };
+
+                    ctx.world.view<TransformComponent, LightComponent>().each(sync);
+                    m_level_world->view<TransformComponent, LightComponent>().each(sync);
+                    m_level->update_lighting(*m_fov);
+                });
+
+        // Text textures are rendered through SDL, keep it on the main thread.
+        // The debug text only depends on the player position.
+        m_update_systems.add_exclusive_system(
+                "text",
+                [this](SystemContext& ctx)
+                {
+                    auto transform = ctx.world.get_component<TransformComponent>(player);
+                    if (transform && !transform->changed_since(ctx.last_run)) return;
+
+                    ctx.world.view<TextComponent>().each([](TextComponent& text) { text.update(); });
+                });
+    }
 
-                switch (tile)
+    void update_offset()
+    {
+        m_world.view<TransformComponent, OffsetComponent>().each(
+                [this](TransformComponent& transform, OffsetComponent& offset)
                 {
-                    case TileType::Wall:
-                        sprite_col = 0;
-                        break;
-                    case TileType::Empty:
-                        sprite_col = 1;
-                        break;
-                    case TileType::StairsDown:
-                        sprite_col = 2;
-                        break;
-                    case TileType::StairsUp:
-                        break;
-                }
+                    offset.update(m_world, transform);
+                });
+    }
 
-                entity->add_component<TransformComponent>(Vector2D { x, y });
-                entity->add_component<SpriteComponent>(m_window, sprite);
-                entity->add_component<SpriteRenderComponent>(sprite_col, 0, [](int x, int y){ return true; }, offset);
-            }
-        }
+    void update()
+    {
+        m_update_systems.run(m_world);
+    }
+
+    // The persistent world only holds the player's sprite, a plain view
+    // is fine there
+    void draw_sprites(World& world, const Camera& camera)
+    {
+        world.view<TransformComponent, SpriteComponent, SpriteRenderComponent>().each(
+                [&](TransformComponent& transform, SpriteComponent& sprite, SpriteRenderComponent& render)
+                {
+                    render.draw(m_batch, camera, transform, sprite);
+                });
+    }
+
+    void draw_level_sprites(const Camera& camera)
+    {
+        auto& world = *m_level_world;
+        m_level_sprites.query(camera.x0, camera.y0, camera.x1, camera.y1,
+                [&](EntityId e, Vector2D)
+                {
+                    auto render = world.get_component<SpriteRenderComponent>(e);
+                    if (!render) return;
+                    render->draw(m_batch, camera, world.get<TransformComponent>(e), world.get<SpriteComponent>(e));
+                });
+    }
+
+    void draw()
+    {
+        auto camera = m_world.get<OffsetComponent>(offset).camera();
+
+        m_tile_layer->draw(*m_level, camera);
+        draw_level_sprites(camera);
+        draw_sprites(m_world, camera);
+
+        m_batch.flush(m_window->get_renderer());
+
+        m_world.view<SpriteComponent, DarknessComponent>().each(
+                [&](SpriteComponent& sprite, DarknessComponent& darkness)
+                {
+                    darkness.draw(camera, sprite);
+                });
+
+        m_world.view<TransformComponent, TextComponent, TextRenderComponent>().each(
+                [](TransformComponent& transform, TextComponent& text, TextRenderComponent& render)
+                {
+                    render.draw(transform, text);
+                });
     }
 };
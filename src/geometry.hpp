@@ -40,6 +40,58 @@ inline int center_x(Rect r) { return ((r.x1 - r.x0) / 2) + r.x0; }
 inline int center_y(Rect r) { return ((r.y1 - r.y0) / 2) + r.y0; }
 inline Vector2D center(Rect r) { return Vector2D(center_x(r), center_y(r)); }
 
+// What is on screen this frame. `offset` maps map cells to screen
+// cells; x0..x1, y0..y1 (exclusive) are the visible map cells, clipped
+// to the map.
+struct Camera
+{
+    Vector2D offset;
+    Vector2D playfield;
+    int x0, y0, x1, y1;
+
+    bool contains(Vector2D pos) const
+    {
+        return pos.x >= x0 && pos.y >= y0 && pos.x < x1 && pos.y < y1;
+    }
+};
+
+enum class MovementDirection {
+    None, Up, Down, Left, Right
+};
+
+inline MovementDirection opposite_direction(MovementDirection direction)
+{
+    switch(direction)
+    {
+        case MovementDirection::Up:
+            return MovementDirection::Down;
+            break;
+        case MovementDirection::Down:
+            return MovementDirection::Up;
+            break;
+        case MovementDirection::Left:
+            return MovementDirection::Right;
+            break;
+        case MovementDirection::Right:
+            return MovementDirection::Left;
+            break;
+        case MovementDirection::None:
+            return MovementDirection::None;
+            break;
+    }
+};
+
+// Step from `from` to the 4-neighbour `to`, None for any other cell
+inline MovementDirection direction_to(Vector2D from, Vector2D to)
+{
+    auto d = to - from;
+    if (d.x == 0 && d.y == -1) return MovementDirection::Up;
+    if (d.x == 0 && d.y == 1) return MovementDirection::Down;
+    if (d.x == -1 && d.y == 0) return MovementDirection::Left;
+    if (d.x == 1 && d.y == 0) return MovementDirection::Right;
+    return MovementDirection::None;
+}
+
 namespace std {
   template<> struct hash<Vector2D> {
     // hash fn taken from https://stackoverflow.com/questions/20590656/error-for-hash-function-of-pair-of-ints
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace heap
+{
+    // Calls to global operator new, the ECS's included. Only debug builds of
+    // the game count them, core.cpp replaces operator new there; anywhere
+    // else this stays 0.
+    inline std::atomic<std::size_t>& allocations()
+    {
+        static std::atomic<std::size_t> count { 0 };
+        return count;
+    }
+};
@@ -14,15 +14,17 @@ namespace logger {
                 std::mutex write_mutex;
 
             public:
+                // Appends to `fname`, stdout only when it can't be opened
                 Writer(std::string fname) : fname(fname) {
-                    /* fstream.open(fname, std::ios::out | std::ios::app); */
+                    fstream.open(fname, std::ios::out | std::ios::app);
                 };
 
                 template<typename First>
                 void print(First first){
-                    /* std::lock_guard<std::mutex> guard(write_mutex); */
-                    std::cout << first;
-                    /* fstream << first; */
+                    if (fstream.is_open())
+                        fstream << first;
+                    else
+                        std::cout << first;
                 }
 
                 template<typename First, typename... Rest>
@@ -32,13 +34,26 @@ namespace logger {
                     print(rest...);
                 }
 
+                // Whole line under the lock, levels may be generated on
+                // worker threads
+                template<typename... Rest>
+                void line(const char* prefix, Rest... rest){
+                    std::lock_guard<std::mutex> guard(write_mutex);
+                    print(prefix);
+                    print(rest...);
+                    print('\n');
+                }
+
                 void flush() {
-                    /* std::lock_guard<std::mutex> guard(write_mutex); */
-                    /* fstream.flush(); */
+                    std::lock_guard<std::mutex> guard(write_mutex);
+                    if (fstream.is_open())
+                        fstream.flush();
+                    else
+                        std::cout.flush();
                 }
 
                 ~Writer() {
-                    /* fstream.close(); */
+                    fstream.close();
                 }
         };
 
@@ -56,17 +71,13 @@ namespace logger {
 
     template<typename... Rest>
     inline void info(Rest... rest){
-        logger->print("<INFO> ");
-        logger->print(rest...);
-        logger->print('\n');
+        logger->line("<INFO> ", rest...);
         logger->flush();
     }
 
     template<typename... Rest>
     inline void critical(Rest... rest){
-        logger->print("<OMGPANIC> ");
-        logger->print(rest...);
-        logger->print('\n');
+        logger->line("<OMGPANIC> ", rest...);
         logger->flush();
     }
 }
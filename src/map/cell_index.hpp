@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "../random.hpp"
+#include "../geometry.hpp"
+#include "grid.hpp"
+
+// Set of cells (e.g. every empty tile) kept three ways: a dense list for
+// O(1) uniform sampling, each cell's slot in that list for O(1) insert and
+// swap-remove, and a bitplane for sampling inside a region with a few
+// popcounts per row.
+class CellIndex {
+    private:
+        std::vector<std::uint32_t> m_cells;
+        Grid<std::int32_t> m_slots;
+        BitGrid m_bits;
+
+        Vector2D coords(std::uint32_t cell) const {
+            return Vector2D { static_cast<int>(cell % m_slots.get_w()), static_cast<int>(cell / m_slots.get_w()) };
+        }
+
+        void swap_slots(std::size_t a, std::size_t b) {
+            std::swap(m_cells[a], m_cells[b]);
+            auto pa = coords(m_cells[a]);
+            auto pb = coords(m_cells[b]);
+            m_slots.set(pa.x, pa.y, static_cast<std::int32_t>(a));
+            m_slots.set(pb.x, pb.y, static_cast<std::int32_t>(b));
+        }
+
+    public:
+        CellIndex() {};
+        explicit CellIndex(int w, int h) : m_slots { w, h, -1 }, m_bits { w, h } {};
+
+        // Indexes every cell of `grid` for which pred(value) holds
+        template <typename T, typename P>
+        void build(const Grid<T> &grid, P&& pred) {
+            m_cells.clear();
+            m_slots.fill(-1);
+            m_bits.clear();
+
+            for (int y = 0; y < grid.get_h(); ++y) {
+                auto row = grid.row(y);
+                for (int x = 0; x < grid.get_w(); ++x) {
+                    if (pred(row[x])) {
+                        insert(x, y);
+                    }
+                }
+            }
+        }
+
+        std::size_t size() const { return m_cells.size(); }
+        bool empty() const { return m_cells.empty(); }
+        bool contains(int x, int y) const { return m_slots.get(x, y) >= 0; }
+
+        void insert(int x, int y) {
+            if (contains(x, y)) {
+                return;
+            }
+
+            m_slots.set(x, y, static_cast<std::int32_t>(m_cells.size()));
+            m_cells.push_back(static_cast<std::uint32_t>(m_slots.index(x, y)));
+            m_bits.set(x, y);
+        }
+
+        void erase(int x, int y) {
+            auto slot = m_slots.get(x, y);
+            if (slot < 0) {
+                return;
+            }
+
+            swap_slots(static_cast<std::size_t>(slot), m_cells.size() - 1);
+            m_cells.pop_back();
+            m_slots.set(x, y, -1);
+            m_bits.reset(x, y);
+        }
+
+        // Uniform over all cells, throws when there are none
+        Vector2D sample(rng::Rng &rng) const {
+            if (m_cells.empty()) {
+                throw std::runtime_error("Sampling from an empty cell index");
+            }
+            return coords(m_cells[rng.gen_int(0, static_cast<int>(m_cells.size()))]);
+        }
+
+        // Uniform over the cells inside `region`, nothing when it holds none
+        std::optional<Vector2D> sample(rng::Rng &rng, Rect region) const {
+            std::size_t total = 0;
+            for (int y = std::max(0, region.y0); y < std::min(m_bits.get_h(), region.y1); ++y) {
+                total += m_bits.count(y, region.x0, region.x1);
+            }
+
+            if (total == 0) {
+                return std::nullopt;
+            }
+
+            auto n = static_cast<std::size_t>(rng.gen_int(0, static_cast<int>(total)));
+            for (int y = std::max(0, region.y0); ; ++y) {
+                auto c = m_bits.count(y, region.x0, region.x1);
+                if (n < c) {
+                    return Vector2D { m_bits.nth(y, region.x0, region.x1, n), y };
+                }
+                n -= c;
+            }
+        }
+
+        // n distinct cells, uniformly; fewer when the index holds fewer.
+        // A partial Fisher-Yates shuffle of the list, O(n).
+        std::vector<Vector2D> sample(rng::Rng &rng, std::size_t n) {
+            n = std::min(n, m_cells.size());
+
+            std::vector<Vector2D> out;
+            out.reserve(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                auto j = static_cast<std::size_t>(rng.gen_int(static_cast<int>(i), static_cast<int>(m_cells.size())));
+                swap_slots(i, j);
+                out.push_back(coords(m_cells[i]));
+            }
+            return out;
+        }
+
+        const BitGrid& cells() const { return m_bits; }
+};
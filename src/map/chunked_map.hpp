@@ -0,0 +1,517 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "../random.hpp"
+#include "../logging.hpp"
+#include "../geometry.hpp"
+#include "grid.hpp"
+#include "generators.hpp"
+
+struct ChunkCoord {
+    int x;
+    int y;
+
+    bool operator==(const ChunkCoord &o) const { return x == o.x && y == o.y; }
+};
+
+namespace std {
+  template<> struct hash<ChunkCoord> {
+    size_t operator()(ChunkCoord const& c) const {
+        return std::hash<std::uint64_t>{}((static_cast<std::uint64_t>(static_cast<std::uint32_t>(c.x)) << 32) | static_cast<std::uint32_t>(c.y));
+    }
+  };
+}
+
+// 32x32 cells of a ChunkedMap
+class Chunk {
+    public:
+        static constexpr int size = 32;
+
+    private:
+        std::array<TileType, size * size> m_tiles;
+        // One row per word
+        std::array<std::uint32_t, size> m_memoized {};
+        bool m_dirty = false;
+
+    public:
+        Chunk() { m_tiles.fill(TileType::Wall); }
+
+        TileType get(int x, int y) const { return m_tiles[y * size + x]; }
+        void set(int x, int y, TileType type) { m_tiles[y * size + x] = type; m_dirty = true; }
+
+        bool memoized(int x, int y) const { return (m_memoized[y] >> x) & 1; }
+        void memoize(int x, int y) {
+            if (!memoized(x, y)) {
+                m_memoized[y] |= std::uint32_t { 1 } << x;
+                m_dirty = true;
+            }
+        }
+
+        // Changed since it was generated or loaded, needs writing on eviction
+        bool dirty() const { return m_dirty; }
+        void mark_clean() { m_dirty = false; }
+
+        // Compact on disk format: a magic, tiles as (run length, type) byte
+        // pairs, then the memoized rows. A generated chunk is ~100-300 bytes.
+        void write(std::ostream &out) const {
+            out.write("TPC1", 4);
+            for (int i = 0; i < size * size;) {
+                int run = 1;
+                while (i + run < size * size && run < 255 && m_tiles[i + run] == m_tiles[i]) {
+                    ++run;
+                }
+                char pair[2] = { static_cast<char>(run), static_cast<char>(m_tiles[i]) };
+                out.write(pair, 2);
+                i += run;
+            }
+            out.write(reinterpret_cast<const char*>(m_memoized.data()), sizeof(m_memoized));
+        }
+
+        bool read(std::istream &in) {
+            char magic[4];
+            if (!in.read(magic, 4) || std::string(magic, 4) != "TPC1") {
+                return false;
+            }
+
+            for (int i = 0; i < size * size;) {
+                unsigned char pair[2];
+                if (!in.read(reinterpret_cast<char*>(pair), 2) || pair[0] == 0 || i + pair[0] > size * size) {
+                    return false;
+                }
+                std::fill(m_tiles.begin() + i, m_tiles.begin() + i + pair[0], static_cast<TileType>(pair[1]));
+                i += pair[0];
+            }
+
+            if (!in.read(reinterpret_cast<char*>(m_memoized.data()), sizeof(m_memoized))) {
+                return false;
+            }
+            m_dirty = false;
+            return true;
+        }
+};
+
+// Unbounded map made of chunks. Only the chunks around the focus point are
+// kept in memory; the rest are generated from the seed when they come into
+// range, or read back from the page directory if they were changed (e.g.
+// explored) before being evicted. Memory is bounded by the resident radius,
+// not the world size.
+// All disk and generation work runs on one loader thread owned by the map,
+// in request order, so a chunk paged out and requested again is read back
+// after it was written.
+// Chunks are generated independently: every chunk gets doors at fixed,
+// seed derived spots on its four edges which both neighbours agree on, all
+// corridored to its centre (the hub), so the world stays connected. One in
+// stairs_one_in chunks gets stairs down somewhere off its hub.
+class ChunkedMap {
+    private:
+        using ChunkPtr = std::unique_ptr<Chunk>;
+
+        std::uint64_t m_seed;
+        const Generator &m_generator;
+        int m_radius;
+        std::string m_page_dir;
+
+        // Only touched by the owning thread
+        std::unordered_map<ChunkCoord, ChunkPtr> m_resident;
+        // Requested, not adopted yet
+        std::unordered_set<ChunkCoord> m_pending;
+
+        // A load when `chunk` is null, a page out otherwise
+        struct Job {
+            ChunkCoord coord;
+            ChunkPtr chunk;
+        };
+
+        // Shared with the loader thread
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_idle;
+        std::deque<Job> m_jobs;
+        std::vector<std::pair<ChunkCoord, ChunkPtr>> m_loaded;
+        bool m_busy = false;
+        bool m_stop = false;
+        std::thread m_loader;
+
+        static int floor_div(int a, int b) {
+            int q = a / b;
+            return (a % b != 0 && ((a < 0) != (b < 0))) ? q - 1 : q;
+        }
+
+        static std::uint64_t mix(std::uint64_t seed, std::uint64_t a, std::uint64_t b, std::uint64_t salt) {
+            std::uint64_t state = seed ^ (a * 0x9e3779b97f4a7c15ull) ^ (b * 0xc2b2ae3d27d4eb4full) ^ (salt << 56);
+            return rng::splitmix64(state);
+        }
+
+        // Door position along the edge shared by two chunks. Horizontal
+        // edges are identified by the chunk below them, vertical ones by
+        // the chunk to their right.
+        static int door(std::uint64_t seed, int cx, int cy, bool horizontal) {
+            auto h = mix(seed, static_cast<std::uint32_t>(cx), static_cast<std::uint32_t>(cy), horizontal ? 1 : 2);
+            return 2 + static_cast<int>(h % (Chunk::size - 4));
+        }
+
+        static void carve_line(Grid<TileType> &tiles, Vector2D from, Vector2D to) {
+            int x = from.x;
+            int y = from.y;
+            tiles.set(x, y, TileType::Empty);
+            while (x != to.x) {
+                x += x < to.x ? 1 : -1;
+                tiles.set(x, y, TileType::Empty);
+            }
+            while (y != to.y) {
+                y += y < to.y ? 1 : -1;
+                tiles.set(x, y, TileType::Empty);
+            }
+        }
+
+        static ChunkPtr generate(std::uint64_t seed, const Generator &generator, ChunkCoord c) {
+            constexpr int s = Chunk::size;
+            Grid<TileType> tiles { s, s, TileType::Wall };
+            rng::Rng rng { mix(seed, static_cast<std::uint32_t>(c.x), static_cast<std::uint32_t>(c.y), 0) };
+            generator.generate(tiles, rng);
+
+            // Whatever the generator made gets joined to the hub
+            Vector2D hub { s / 2, s / 2 };
+            Vector2D inner = hub;
+            int best = s * s;
+            for (int y = 0; y < s; ++y) {
+                for (int x = 0; x < s; ++x) {
+                    int d = std::abs(x - hub.x) + std::abs(y - hub.y);
+                    if (tiles.get(x, y) == TileType::Empty && d < best) {
+                        best = d;
+                        inner = Vector2D { x, y };
+                    }
+                }
+            }
+            carve_line(tiles, hub, inner);
+
+            carve_line(tiles, Vector2D { door(seed, c.x, c.y, true), 0 }, hub);
+            carve_line(tiles, Vector2D { door(seed, c.x, c.y + 1, true), s - 1 }, hub);
+            carve_line(tiles, Vector2D { 0, door(seed, c.x, c.y, false) }, hub);
+            carve_line(tiles, Vector2D { s - 1, door(seed, c.x + 1, c.y, false) }, hub);
+
+            if (mix(seed, static_cast<std::uint32_t>(c.x), static_cast<std::uint32_t>(c.y), 3) % stairs_one_in == 0) {
+                std::vector<Vector2D> open;
+                for (int y = 0; y < s; ++y) {
+                    for (int x = 0; x < s; ++x) {
+                        if (tiles.get(x, y) == TileType::Empty && !(Vector2D { x, y } == hub)) {
+                            open.push_back(Vector2D { x, y });
+                        }
+                    }
+                }
+                auto stairs = open[rng.gen_int(0, static_cast<int>(open.size()))];
+                tiles.set(stairs.x, stairs.y, TileType::StairsDown);
+            }
+
+            auto chunk = std::make_unique<Chunk>();
+            for (int y = 0; y < s; ++y) {
+                for (int x = 0; x < s; ++x) {
+                    chunk->set(x, y, tiles.get(x, y));
+                }
+            }
+            // Freshly generated equals what the seed gives, nothing to page
+            chunk->mark_clean();
+            return chunk;
+        }
+
+        // Paging is off when the directory cannot be made
+        static std::string prepare(std::string page_dir) {
+            if (page_dir.empty()) {
+                return page_dir;
+            }
+
+            std::error_code error;
+            std::filesystem::create_directories(page_dir, error);
+            if (error) {
+                logger::critical("Cannot page chunks to", page_dir, error.message());
+                return "";
+            }
+            return page_dir;
+        }
+
+        std::string page_path(ChunkCoord c) const {
+            return m_page_dir + "/chunk_" + std::to_string(c.x) + "_" + std::to_string(c.y) + ".bin";
+        }
+
+        // Reads a paged out chunk or generates it, on the loader thread
+        ChunkPtr load(ChunkCoord c) const {
+            if (!m_page_dir.empty()) {
+                std::ifstream in { page_path(c), std::ios::binary };
+                if (in) {
+                    auto chunk = std::make_unique<Chunk>();
+                    if (chunk->read(in)) {
+                        return chunk;
+                    }
+                    logger::info("Ignoring unreadable chunk page", page_path(c));
+                }
+            }
+            return generate(m_seed, m_generator, c);
+        }
+
+        // On the loader thread
+        void store(ChunkCoord c, const Chunk &chunk) const {
+            std::ofstream out { page_path(c), std::ios::binary | std::ios::trunc };
+            chunk.write(out);
+            if (!out) {
+                logger::critical("Failed to page out chunk", c.x, c.y);
+            }
+        }
+
+        void run() {
+            std::unique_lock<std::mutex> lock { m_mutex };
+            for (;;) {
+                m_wake.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+                if (m_jobs.empty()) {
+                    return;
+                }
+
+                auto job = std::move(m_jobs.front());
+                m_jobs.pop_front();
+                m_busy = true;
+                lock.unlock();
+
+                ChunkPtr loaded;
+                if (job.chunk) {
+                    store(job.coord, *job.chunk);
+                } else {
+                    loaded = load(job.coord);
+                }
+
+                lock.lock();
+                if (loaded) {
+                    m_loaded.emplace_back(job.coord, std::move(loaded));
+                }
+                m_busy = false;
+                if (m_jobs.empty()) {
+                    m_idle.notify_all();
+                }
+            }
+        }
+
+        // Queues the write of a changed chunk, call with m_mutex held
+        void evict(ChunkCoord c, ChunkPtr chunk) {
+            if (chunk->dirty() && !m_page_dir.empty()) {
+                m_jobs.push_back(Job { c, std::move(chunk) });
+            }
+        }
+
+        // Moves finished loads into the resident set
+        void adopt() {
+            std::vector<std::pair<ChunkCoord, ChunkPtr>> loaded;
+            {
+                std::lock_guard<std::mutex> guard { m_mutex };
+                loaded.swap(m_loaded);
+            }
+            for (auto &[c, chunk] : loaded) {
+                m_pending.erase(c);
+                m_resident[c] = std::move(chunk);
+            }
+        }
+
+        static ChunkCoord locate(int x, int y, int &lx, int &ly) {
+            ChunkCoord c { floor_div(x, Chunk::size), floor_div(y, Chunk::size) };
+            lx = x - c.x * Chunk::size;
+            ly = y - c.y * Chunk::size;
+            return c;
+        }
+
+        Chunk* find(int x, int y, int &lx, int &ly) {
+            auto it = m_resident.find(locate(x, y, lx, ly));
+            return it != m_resident.end() ? it->second.get() : nullptr;
+        }
+
+        const Chunk* find(int x, int y, int &lx, int &ly) const {
+            auto it = m_resident.find(locate(x, y, lx, ly));
+            return it != m_resident.end() ? it->second.get() : nullptr;
+        }
+
+    public:
+        static constexpr int stairs_one_in = 4;
+
+        // Keeps chunks within `radius` chunks of the focus resident. With an
+        // empty `page_dir` changed chunks are dropped on eviction and come
+        // back as generated; otherwise the directory is created if needed.
+        ChunkedMap(std::uint64_t seed, const Generator &generator, int radius = 2, std::string page_dir = "")
+        : m_seed { seed }, m_generator { generator }, m_radius { radius }, m_page_dir { prepare(page_dir) },
+          m_loader { [this] { run(); } }
+        { }
+
+        // Writes the changed resident chunks out before returning; queued
+        // loads are dropped
+        ~ChunkedMap() {
+            {
+                std::lock_guard<std::mutex> guard { m_mutex };
+                m_jobs.erase(std::remove_if(m_jobs.begin(), m_jobs.end(), [](const Job &job) { return !job.chunk; }), m_jobs.end());
+                for (auto &[c, chunk] : m_resident) {
+                    evict(c, std::move(chunk));
+                }
+                m_stop = true;
+            }
+            m_wake.notify_one();
+            m_loader.join();
+        }
+
+        ChunkedMap(const ChunkedMap&) = delete;
+        ChunkedMap& operator=(const ChunkedMap&) = delete;
+
+        static ChunkCoord chunk_of(Vector2D cell) {
+            return ChunkCoord { floor_div(cell.x, Chunk::size), floor_div(cell.y, Chunk::size) };
+        }
+
+        // Always open and never stairs
+        static Vector2D hub(ChunkCoord c) {
+            return Vector2D { c.x * Chunk::size + Chunk::size / 2, c.y * Chunk::size + Chunk::size / 2 };
+        }
+
+        const std::string& page_dir() const { return m_page_dir; }
+        int radius() const { return m_radius; }
+
+        // Call when the camera moves: adopts finished chunks, queues the
+        // missing ones around `cell` and evicts those out of range. Loads
+        // still queued for chunks out of range are dropped.
+        // Never blocks on generation or disk.
+        void focus(Vector2D cell) {
+            adopt();
+
+            auto center = chunk_of(cell);
+            // One chunk of slack so walking along a border does not thrash
+            auto out_of_range = [&](ChunkCoord c) {
+                return std::abs(c.x - center.x) > m_radius + 1 || std::abs(c.y - center.y) > m_radius + 1;
+            };
+
+            {
+                std::lock_guard<std::mutex> guard { m_mutex };
+                for (auto it = m_jobs.begin(); it != m_jobs.end();) {
+                    if (!it->chunk && out_of_range(it->coord)) {
+                        m_pending.erase(it->coord);
+                        it = m_jobs.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+
+                for (auto it = m_resident.begin(); it != m_resident.end();) {
+                    if (out_of_range(it->first)) {
+                        evict(it->first, std::move(it->second));
+                        it = m_resident.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+
+                for (int cy = center.y - m_radius; cy <= center.y + m_radius; ++cy) {
+                    for (int cx = center.x - m_radius; cx <= center.x + m_radius; ++cx) {
+                        ChunkCoord c { cx, cy };
+                        if (m_resident.count(c) || m_pending.count(c)) {
+                            continue;
+                        }
+                        m_pending.insert(c);
+                        m_jobs.push_back(Job { c, nullptr });
+                    }
+                }
+            }
+            m_wake.notify_one();
+        }
+
+        // Blocks until the loader is through its queue, page outs included,
+        // and every requested chunk is resident
+        void wait() {
+            {
+                std::unique_lock<std::mutex> lock { m_mutex };
+                m_idle.wait(lock, [this] { return m_jobs.empty() && !m_busy; });
+            }
+            adopt();
+        }
+
+        std::size_t resident_count() const { return m_resident.size(); }
+        std::size_t pending_count() const { return m_pending.size(); }
+
+        bool resident(int x, int y) const {
+            int lx, ly;
+            return find(x, y, lx, ly) != nullptr;
+        }
+
+        // Adopts finished loads, then tells whether every chunk overlapping
+        // `region` is resident. Never blocks.
+        bool resident(Rect region) {
+            adopt();
+            auto from = chunk_of(Vector2D { region.x0, region.y0 });
+            auto to = chunk_of(Vector2D { region.x1 - 1, region.y1 - 1 });
+            for (int cy = from.y; cy <= to.y; ++cy) {
+                for (int cx = from.x; cx <= to.x; ++cx) {
+                    if (!m_resident.count(ChunkCoord { cx, cy })) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        // Forgets every chunk without paging anything out, for a world
+        // which is thrown away with its pages. Only a page out the loader
+        // already started still completes.
+        void discard() {
+            {
+                std::lock_guard<std::mutex> guard { m_mutex };
+                m_jobs.clear();
+                m_loaded.clear();
+            }
+            m_pending.clear();
+            m_resident.clear();
+        }
+
+        // Cells of chunks which are not resident read as walls
+        TileType at(int x, int y) const {
+            int lx, ly;
+            auto chunk = find(x, y, lx, ly);
+            return chunk ? chunk->get(lx, ly) : TileType::Wall;
+        }
+
+        bool memoized(int x, int y) const {
+            int lx, ly;
+            auto chunk = find(x, y, lx, ly);
+            return chunk && chunk->memoized(lx, ly);
+        }
+
+        // Ignored outside resident chunks
+        void memoize(int x, int y) {
+            int lx, ly;
+            if (auto chunk = find(x, y, lx, ly)) {
+                chunk->memoize(lx, ly);
+            }
+        }
+
+        void set_tile(int x, int y, TileType type) {
+            int lx, ly;
+            if (auto chunk = find(x, y, lx, ly)) {
+                chunk->set(lx, ly, type);
+            }
+        }
+
+        // Copies `region` into `out` (sized to the region), so FOV, lighting
+        // and the other flat Grid users can run on a window of the world
+        void copy_region(Rect region, Grid<TileType> &out) const {
+            for (int y = region.y0; y < region.y1; ++y) {
+                auto row = out.row(y - region.y0);
+                for (int x = region.x0; x < region.x1; ++x) {
+                    row[x - region.x0] = at(x, y);
+                }
+            }
+        }
+};
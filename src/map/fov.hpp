@@ -0,0 +1,241 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <math.h>
+
+#include "../geometry.hpp"
+#include "grid.hpp"
+
+// Field of view algorithm. compute() only sets bits in `visible` for cells
+// within `radius` of `origin`; clearing the buffer is up to the caller.
+// Cells outside the map are treated as opaque. `visible` may cover just a
+// box of the map with its top left at `corner`, e.g. the (2r+1)^2 square
+// a light can reach; cells outside it are not recorded.
+class Fov {
+    public:
+        virtual ~Fov() {};
+        virtual void compute(const Grid<TileType> &map, Vector2D origin, int radius, BitGrid &visible, Vector2D corner) const = 0;
+
+        void compute(const Grid<TileType> &map, Vector2D origin, int radius, BitGrid &visible) const {
+            compute(map, origin, radius, visible, Vector2D { 0, 0 });
+        }
+};
+
+// Symmetric recursive shadowcasting, after Albert Ford's description
+// https://www.albertford.com/shadowcasting/
+// Every cell is visited at most once per octant pair and A sees B exactly
+// when B sees A. Slopes are kept as exact fractions.
+class ShadowcastingFov : public Fov {
+    private:
+        struct Slope {
+            int num;
+            int den;
+        };
+
+        struct Quadrant {
+            Vector2D origin;
+            int dir;
+
+            // (depth, col) relative to the quadrant to map coordinates
+            Vector2D transform(int depth, int col) const {
+                switch (dir) {
+                    case 0: return Vector2D { origin.x + col, origin.y - depth };
+                    case 1: return Vector2D { origin.x + depth, origin.y + col };
+                    case 2: return Vector2D { origin.x + col, origin.y + depth };
+                    default: return Vector2D { origin.x - depth, origin.y + col };
+                }
+            }
+        };
+
+        static int floor_div(int a, int b) {
+            int q = a / b;
+            return (a % b != 0 && ((a < 0) != (b < 0))) ? q - 1 : q;
+        }
+
+        // floor(depth * slope + 1/2) and ceil(depth * slope - 1/2)
+        static int round_ties_up(int depth, Slope s) { return floor_div(2 * depth * s.num + s.den, 2 * s.den); }
+        static int round_ties_down(int depth, Slope s) { return -floor_div(-(2 * depth * s.num - s.den), 2 * s.den); }
+
+        static bool is_symmetric(int depth, int col, Slope start, Slope end) {
+            return col * start.den >= depth * start.num && col * end.den <= depth * end.num;
+        }
+
+        static bool opaque(const Grid<TileType> &map, Vector2D p) {
+            return !map.in_bounds(p.x, p.y) || map.get(p.x, p.y) == TileType::Wall;
+        }
+
+        static void reveal(Vector2D p, Vector2D origin, int radius, BitGrid &visible, Vector2D corner) {
+            auto d = p - origin;
+            auto b = p - corner;
+            if (d.x * d.x + d.y * d.y <= radius * radius && visible.in_bounds(b.x, b.y)) {
+                visible.set(b.x, b.y);
+            }
+        }
+
+        static void scan(const Grid<TileType> &map, const Quadrant &q, int radius, int depth, Slope start, Slope end, BitGrid &visible, Vector2D corner) {
+            if (depth > radius) {
+                return;
+            }
+
+            int min_col = round_ties_up(depth, start);
+            int max_col = round_ties_down(depth, end);
+
+            // -1 before the first cell, then 0 floor, 1 wall
+            int prev = -1;
+            for (int col = min_col; col <= max_col; ++col) {
+                auto p = q.transform(depth, col);
+                bool wall = opaque(map, p);
+
+                if (wall || is_symmetric(depth, col, start, end)) {
+                    reveal(p, q.origin, radius, visible, corner);
+                }
+
+                if (prev == 1 && !wall) {
+                    start = Slope { 2 * col - 1, 2 * depth };
+                }
+
+                if (prev == 0 && wall) {
+                    scan(map, q, radius, depth + 1, start, Slope { 2 * col - 1, 2 * depth }, visible, corner);
+                }
+
+                prev = wall ? 1 : 0;
+            }
+
+            if (prev == 0) {
+                scan(map, q, radius, depth + 1, start, end, visible, corner);
+            }
+        }
+
+    public:
+        using Fov::compute;
+
+        void compute(const Grid<TileType> &map, Vector2D origin, int radius, BitGrid &visible, Vector2D corner) const override {
+            reveal(origin, origin, radius, visible, corner);
+
+            for (int dir = 0; dir < 4; ++dir) {
+                scan(map, Quadrant { origin, dir }, radius, 1, Slope { -1, 1 }, Slope { 1, 1 }, visible, corner);
+            }
+        }
+};
+
+// The original 360 float rays marched from the cell centre.
+// Over-samples near cells and misses far ones between rays; kept for
+// comparison.
+class RaycastingFov : public Fov {
+    private:
+        // Implementation based on this pseudo code http://www.roguebasin.com/index.php?title=Eligloscode
+        static void cast_ray(float x, float y, Vector2D origin, const Grid<TileType> &map, int radius, BitGrid &visible, Vector2D corner) {
+            float ox = static_cast<float>(origin.x) + 0.5f;
+            float oy = static_cast<float>(origin.y) + 0.5f;
+
+            for (int i = 0; i < radius; ++i) {
+                int tx = static_cast<int>(ox);
+                int ty = static_cast<int>(oy);
+
+                if (!map.in_bounds(tx, ty)) {
+                    return;
+                }
+
+                if (visible.in_bounds(tx - corner.x, ty - corner.y)) {
+                    visible.set(tx - corner.x, ty - corner.y);
+                }
+
+                if (map.get(tx, ty) == TileType::Wall) {
+                    return;
+                }
+
+                ox += x;
+                oy += y;
+            }
+        }
+
+    public:
+        using Fov::compute;
+
+        void compute(const Grid<TileType> &map, Vector2D origin, int radius, BitGrid &visible, Vector2D corner) const override {
+            for (int i = 0; i < 360; ++i) {
+                float fi = static_cast<float>(i);
+                cast_ray(cos(fi*0.01745f), sin(fi*0.01745f), origin, map, radius, visible, corner);
+            }
+        }
+};
+
+enum LightLevel {
+    Invisible,
+    Dim,
+    Visible
+};
+
+// Visibility buffer filled by a Fov. Kept across moves: recomputing only
+// clears the square the previous light could reach, and is skipped when
+// neither the light nor a tile within its reach changed.
+class LightMap {
+    private:
+        BitGrid m_visible;
+        Vector2D m_origin { 0, 0 };
+        int m_radius = -1;
+        bool m_dirty = true;
+
+        void clear_previous() {
+            if (m_radius < 0) {
+                return;
+            }
+
+            int y0 = std::max(0, m_origin.y - m_radius);
+            int y1 = std::min(m_visible.get_h(), m_origin.y + m_radius + 1);
+            int w0 = std::max(0, m_origin.x - m_radius) / BitGrid::word_bits;
+            int w1 = std::min(m_visible.get_w() - 1, m_origin.x + m_radius) / BitGrid::word_bits + 1;
+
+            for (int y = y0; y < y1; ++y) {
+                std::fill(m_visible.row(y) + w0, m_visible.row(y) + w1, 0);
+            }
+        }
+
+    public:
+        LightMap() {};
+        explicit LightMap(int w, int h) : m_visible { w, h } {};
+
+        int get_w() const { return m_visible.get_w(); }
+        int get_h() const { return m_visible.get_h(); }
+        Vector2D origin() const { return m_origin; }
+        int radius() const { return m_radius; }
+
+        bool stale(Vector2D origin, int radius) const {
+            return m_dirty || !(origin == m_origin) || radius != m_radius;
+        }
+
+        // Returns false when the previous result is still valid
+        bool compute(const Fov &fov, const Grid<TileType> &map, Vector2D origin, int radius) {
+            if (!stale(origin, radius)) {
+                return false;
+            }
+
+            clear_previous();
+            fov.compute(map, origin, radius, m_visible);
+            m_origin = origin;
+            m_radius = radius;
+            m_dirty = false;
+            return true;
+        }
+
+        // Call when tile (x, y) changed, forces a recompute if the light
+        // could reach it
+        void tile_changed(int x, int y) {
+            if (std::abs(x - m_origin.x) <= m_radius && std::abs(y - m_origin.y) <= m_radius) {
+                m_dirty = true;
+            }
+        }
+
+        void invalidate() { m_dirty = true; }
+
+        const BitGrid& cells() const { return m_visible; }
+
+        bool visible(int x, int y) const {
+            return m_visible.at(x, y);
+        }
+
+        LightLevel light_level(int x, int y) const {
+            return visible(x, y) ? LightLevel::Visible : LightLevel::Dim;
+        };
+};
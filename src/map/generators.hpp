@@ -0,0 +1,468 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+#include <utility>
+
+#include "../random.hpp"
+#include "../logging.hpp"
+#include "../geometry.hpp"
+#include "grid.hpp"
+
+// Carves a level into `tiles`, which comes filled with walls. Generators
+// keep no state between calls, so one instance can serve several threads,
+// and they only draw randomness from `rng`.
+class Generator {
+    public:
+        virtual ~Generator() {};
+        virtual void generate(Grid<TileType> &tiles, rng::Rng &rng) const = 0;
+
+    protected:
+        static void carve(Grid<TileType> &tiles, Rect rect) {
+            int x0 = std::max(0, rect.x0);
+            int y0 = std::max(0, rect.y0);
+            int x1 = std::min(tiles.get_w(), rect.x1);
+            int y1 = std::min(tiles.get_h(), rect.y1);
+
+            for (int y = y0; y < y1; ++y) {
+                std::fill(tiles.row(y) + x0, tiles.row(y) + x1, TileType::Empty);
+            }
+        }
+
+        // Two cell wide L shaped corridor between the centres of a and b
+        static void connect(Grid<TileType> &tiles, Rect a, Rect b) {
+            // Calculate centers and sort
+            int centers_x[2] = { center_x(a), center_x(b) };
+            int centers_y[2] = { center_y(a), center_y(b) };
+            // The vertical leg runs at the x of whichever centre is lower down,
+            // which after sorting is index 1 when both axes sort the same way
+            int tunnel_y_x_index = ((centers_x[0] > centers_x[1]) == (centers_y[0] > centers_y[1])) ? 1 : 0;
+            if (centers_x[0] > centers_x[1])
+                std::swap(centers_x[0], centers_x[1]);
+            if (centers_y[0] > centers_y[1])
+                std::swap(centers_y[0], centers_y[1]);
+
+            // Make the horizontal part of the tunnel
+            Rect tunnel_x;
+            tunnel_x.x0 = centers_x[0];
+            tunnel_x.y0 = centers_y[0]-1;
+            tunnel_x.x1 = centers_x[1];
+            tunnel_x.y1 = centers_y[0]+1;
+            carve(tiles, tunnel_x);
+            // Make the vertical part of the tunnel
+            Rect tunnel_y;
+            tunnel_y.x0 = centers_x[tunnel_y_x_index] - 1;
+            tunnel_y.y0 = centers_y[0];
+            tunnel_y.x1 = centers_x[tunnel_y_x_index] + 1;
+            tunnel_y.y1 = centers_y[1];
+            carve(tiles, tunnel_y);
+        }
+};
+
+// The original algorithm: random rectangles, each tunnelled to one of the
+// rectangles placed before it. Room count scales with the map area, the
+// defaults give 12-26 rooms on a 100x100 map.
+class RoomsGenerator : public Generator {
+    private:
+        int m_min_rooms;
+        int m_max_rooms;
+        int m_max_room_size;
+
+    public:
+        explicit RoomsGenerator(int min_rooms = 12, int max_rooms = 26, int max_room_size = 10)
+        : m_min_rooms { min_rooms }, m_max_rooms { max_rooms }, m_max_room_size { max_room_size }
+        { }
+
+        void generate(Grid<TileType> &tiles, rng::Rng &rng) const override {
+            int width = tiles.get_w();
+            int height = tiles.get_h();
+            long scale = std::max(1L, static_cast<long>(width) * height / 10000);
+            int nrect = static_cast<int>(rng.gen_int(m_min_rooms, m_max_rooms) * scale);
+            logger::info("Maze number of rectangles is", nrect);
+
+            std::vector<Rect> rects;
+            rects.reserve(nrect);
+            for (int i = 0; i < nrect; ++i) {
+                int size_w = rng.gen_int(3, std::min(m_max_room_size, width));
+                int size_h = rng.gen_int(3, std::min(m_max_room_size, height));
+                Rect rect;
+
+                // start of rect can be anywhere on screen
+                rect.x0 = rng.gen_int(0, width - size_w);
+                rect.y0 = rng.gen_int(0, height - size_h);
+                // add size to starting point
+                rect.x1 = rect.x0 + size_w;
+                rect.y1 = rect.y0 + size_h;
+
+                carve(tiles, rect);
+                // connects rectangle to a random existing one
+                if (!rects.empty()) {
+                    connect(tiles, rect, rects[rng.gen_int(0, static_cast<int>(rects.size()))]);
+                }
+                rects.push_back(rect);
+            }
+        }
+};
+
+// Binary space partitioning: the map is split recursively until parts are
+// small, every leaf gets a room and sibling subtrees are joined by a
+// corridor, so the result is always connected.
+class BspGenerator : public Generator {
+    private:
+        int m_min_leaf;
+
+        // Returns a room inside `area` to connect to
+        Rect split(Grid<TileType> &tiles, rng::Rng &rng, Rect area) const {
+            int w = area.x1 - area.x0;
+            int h = area.y1 - area.y0;
+            bool can_split_x = w >= 2 * m_min_leaf;
+            bool can_split_y = h >= 2 * m_min_leaf;
+
+            if (!can_split_x && !can_split_y) {
+                // Room with a one cell margin, at least 3x3
+                int rw = rng.gen_int(3, std::max(4, w - 1));
+                int rh = rng.gen_int(3, std::max(4, h - 1));
+                Rect room;
+                room.x0 = area.x0 + rng.gen_int(1, std::max(2, w - rw));
+                room.y0 = area.y0 + rng.gen_int(1, std::max(2, h - rh));
+                room.x1 = std::min(area.x1, room.x0 + rw);
+                room.y1 = std::min(area.y1, room.y0 + rh);
+                carve(tiles, room);
+                return room;
+            }
+
+            bool vertical = can_split_x && (!can_split_y || (w > h) || (w == h && rng.gen_int(0, 2) == 0));
+            Rect a = area;
+            Rect b = area;
+            if (vertical) {
+                int at = area.x0 + rng.gen_int(m_min_leaf, w - m_min_leaf + 1);
+                a.x1 = at;
+                b.x0 = at;
+            } else {
+                int at = area.y0 + rng.gen_int(m_min_leaf, h - m_min_leaf + 1);
+                a.y1 = at;
+                b.y0 = at;
+            }
+
+            auto room_a = split(tiles, rng, a);
+            auto room_b = split(tiles, rng, b);
+            connect(tiles, room_a, room_b);
+            return rng.gen_int(0, 2) == 0 ? room_a : room_b;
+        }
+
+    public:
+        explicit BspGenerator(int min_leaf = 8) : m_min_leaf { std::max(5, min_leaf) } { }
+
+        void generate(Grid<TileType> &tiles, rng::Rng &rng) const override {
+            Rect area;
+            area.x0 = 0;
+            area.y0 = 0;
+            area.x1 = tiles.get_w();
+            area.y1 = tiles.get_h();
+            split(tiles, rng, area);
+        }
+};
+
+// Cellular automaton caves: random noise smoothed with the 4-5 rule (a
+// cell becomes wall with 5+ wall neighbours, stays wall with 4+). The
+// grid is packed one bit per cell and the rule is evaluated 64 cells at a
+// time with bit-sliced adders. Only the largest open region is kept so
+// every empty cell is reachable.
+class CaveGenerator : public Generator {
+    private:
+        using Word = BitGrid::Word;
+
+        // 1 in 256 steps
+        int m_wall_chance;
+        int m_iterations;
+
+        static void full_add(Word a, Word b, Word c, Word &sum, Word &carry) {
+            Word t = a ^ b;
+            sum = t ^ c;
+            carry = (a & b) | (c & t);
+        }
+
+        // Bits past the last column are treated as walls too
+        static void pad_solid(BitGrid &grid) {
+            int tail = grid.get_w() % BitGrid::word_bits;
+            if (tail == 0) {
+                return;
+            }
+
+            for (int y = 0; y < grid.get_h(); ++y) {
+                grid.row(y)[grid.row_words() - 1] |= ~Word { 0 } << tail;
+            }
+        }
+
+        // One smoothing step from `src` into `dst`; cells outside the
+        // grid, including the row padding, count as walls
+        static void step(const BitGrid &src, BitGrid &dst, const std::vector<Word> &solid) {
+            int h = src.get_h();
+            int words = src.row_words();
+            const Word* edge = solid.data();
+
+            for (int y = 0; y < h; ++y) {
+                const Word* up = y > 0 ? src.row(y - 1) : edge;
+                const Word* mid = src.row(y);
+                const Word* down = y + 1 < h ? src.row(y + 1) : edge;
+                Word* out = dst.row(y);
+
+                for (int w = 0; w < words; ++w) {
+                    auto left = [&](const Word* r) {
+                        return (r[w] << 1) | (w > 0 ? r[w - 1] >> 63 : Word { 1 });
+                    };
+                    auto right = [&](const Word* r) {
+                        return (r[w] >> 1) | (w + 1 < words ? r[w + 1] << 63 : Word { 1 } << 63);
+                    };
+
+                    Word n[8] = { left(up), up[w], right(up), left(mid), right(mid), left(down), down[w], right(down) };
+
+                    // Sum eight one bit lanes into a four bit count b3..b0
+                    Word s0, c0, s1, c1, b0, k1, t, u, b1, v;
+                    full_add(n[0], n[1], n[2], s0, c0);
+                    full_add(n[3], n[4], n[5], s1, c1);
+                    Word s2 = n[6] ^ n[7];
+                    Word c2 = n[6] & n[7];
+                    full_add(s0, s1, s2, b0, k1);
+                    full_add(c0, c1, c2, t, u);
+                    b1 = t ^ k1;
+                    v = t & k1;
+                    Word b2 = u ^ v;
+                    Word b3 = u & v;
+
+                    Word ge4 = b3 | b2;
+                    Word ge5 = b3 | (b2 & (b1 | b0));
+                    out[w] = ge5 | (mid[w] & ge4);
+                }
+            }
+
+            pad_solid(dst);
+        }
+
+        // Open cells not marked yet, 64 at a time
+        static Word free_word(const BitGrid &walls, const BitGrid &mark, int y, int i) {
+            return ~walls.row(y)[i] & ~mark.row(y)[i];
+        }
+
+        // End of the run of free cells containing x
+        static int run_end(const BitGrid &walls, const BitGrid &mark, int y, int x) {
+            int i = x / BitGrid::word_bits;
+            Word blocked = ~free_word(walls, mark, y, i) >> (x % BitGrid::word_bits);
+            if (blocked != 0) {
+                return x + std::countr_zero(blocked);
+            }
+            for (++i; i < walls.row_words(); ++i) {
+                blocked = ~free_word(walls, mark, y, i);
+                if (blocked != 0) {
+                    return i * BitGrid::word_bits + std::countr_zero(blocked);
+                }
+            }
+            return walls.get_w();
+        }
+
+        // Start of the run of free cells containing x
+        static int run_begin(const BitGrid &walls, const BitGrid &mark, int y, int x) {
+            int i = x / BitGrid::word_bits;
+            int b = x % BitGrid::word_bits;
+            Word below = b == BitGrid::word_bits - 1 ? ~Word { 0 } : (Word { 1 } << (b + 1)) - 1;
+            Word blocked = ~free_word(walls, mark, y, i) & below;
+            for (;;) {
+                if (blocked != 0) {
+                    return i * BitGrid::word_bits + (BitGrid::word_bits - std::countl_zero(blocked));
+                }
+                if (--i < 0) {
+                    return 0;
+                }
+                blocked = ~free_word(walls, mark, y, i);
+            }
+        }
+
+        static void mark_run(BitGrid &mark, int y, int x0, int x1) {
+            auto row = mark.row(y);
+            for (int x = x0; x < x1;) {
+                int i = x / BitGrid::word_bits;
+                int b = x % BitGrid::word_bits;
+                int n = std::min(BitGrid::word_bits - b, x1 - x);
+                Word bits = n == BitGrid::word_bits ? ~Word { 0 } : ((Word { 1 } << n) - 1) << b;
+                row[i] |= bits;
+                x += n;
+            }
+        }
+
+        // Scanline flood fill of the free cells 4-connected to (sx, sy),
+        // marks them in `mark` and returns their number
+        static std::size_t flood(const BitGrid &walls, BitGrid &mark, int sx, int sy, std::vector<std::pair<int, int>> &stack) {
+            std::size_t size = 0;
+            stack.clear();
+            stack.emplace_back(sx, sy);
+
+            while (!stack.empty()) {
+                auto [x, y] = stack.back();
+                stack.pop_back();
+                if (walls.test(x, y) || mark.test(x, y)) {
+                    continue;
+                }
+
+                int x0 = run_begin(walls, mark, y, x);
+                int x1 = run_end(walls, mark, y, x);
+                mark_run(mark, y, x0, x1);
+                size += x1 - x0;
+
+                // Seed every free run touching [x0, x1) in the rows around
+                for (int ny : { y - 1, y + 1 }) {
+                    if (ny < 0 || ny >= walls.get_h()) {
+                        continue;
+                    }
+
+                    Word carry = 0;
+                    for (int i = x0 / BitGrid::word_bits; i <= (x1 - 1) / BitGrid::word_bits; ++i) {
+                        int base = i * BitGrid::word_bits;
+                        Word f = free_word(walls, mark, ny, i);
+                        if (base < x0) f &= ~Word { 0 } << (x0 - base);
+                        if (x1 - base < BitGrid::word_bits) f &= (Word { 1 } << (x1 - base)) - 1;
+
+                        Word starts = f & ~((f << 1) | carry);
+                        carry = f >> (BitGrid::word_bits - 1);
+                        for (; starts != 0; starts &= starts - 1) {
+                            stack.emplace_back(base + std::countr_zero(starts), ny);
+                        }
+                    }
+                }
+            }
+
+            return size;
+        }
+
+        // Keeps the largest 4-connected open region, fills the rest
+        static void keep_largest_region(BitGrid &walls) {
+            int w = walls.get_w();
+            int h = walls.get_h();
+            BitGrid seen { w, h };
+            std::vector<std::pair<int, int>> stack;
+
+            std::size_t best = 0;
+            int best_x = -1;
+            int best_y = -1;
+            for (int y = 0; y < h; ++y) {
+                for (int i = 0; i < walls.row_words(); ++i) {
+                    // Next open cell of the row no region has claimed yet
+                    for (Word f; (f = free_word(walls, seen, y, i)) != 0;) {
+                        int x = i * BitGrid::word_bits + std::countr_zero(f);
+                        auto size = flood(walls, seen, x, y, stack);
+                        if (size > best) {
+                            best = size;
+                            best_x = x;
+                            best_y = y;
+                        }
+                    }
+                }
+            }
+
+            if (best_x < 0) {
+                return;
+            }
+
+            BitGrid keep { w, h };
+            flood(walls, keep, best_x, best_y, stack);
+
+            // walls |= ~keep, word at a time
+            for (int y = 0; y < h; ++y) {
+                auto dst = walls.row(y);
+                auto src = keep.row(y);
+                for (int i = 0; i < walls.row_words(); ++i) {
+                    dst[i] |= ~src[i];
+                }
+            }
+        }
+
+    public:
+        explicit CaveGenerator(int wall_chance = 115, int iterations = 4)
+        : m_wall_chance { wall_chance }, m_iterations { iterations }
+        { }
+
+        void generate(Grid<TileType> &tiles, rng::Rng &rng) const override {
+            int w = tiles.get_w();
+            int h = tiles.get_h();
+            BitGrid a { w, h };
+            BitGrid b { w, h };
+
+            // Noise, one byte of a random draw per cell, 64 cells per word;
+            // the border is solid
+            for (int y = 1; y < h - 1; ++y) {
+                auto row = a.row(y);
+                for (int i = 0; i < a.row_words(); ++i) {
+                    Word bits = 0;
+                    for (int k = 0; k < 8; ++k) {
+                        auto draw = rng.next();
+                        for (int j = 0; j < 8; ++j, draw >>= 8) {
+                            bits |= Word { static_cast<int>(draw & 0xff) < m_wall_chance } << (k * 8 + j);
+                        }
+                    }
+                    row[i] = bits;
+                }
+                a.set(0, y);
+                a.set(w - 1, y);
+            }
+            for (int x = 0; x < w; ++x) {
+                a.set(x, 0);
+                a.set(x, h - 1);
+            }
+            pad_solid(a);
+
+            std::vector<Word> solid(a.row_words(), ~Word { 0 });
+            for (int i = 0; i < m_iterations; ++i) {
+                step(a, b, solid);
+                std::swap(a, b);
+            }
+
+            keep_largest_region(a);
+
+            for (int y = 0; y < h; ++y) {
+                auto row = tiles.row(y);
+                auto bits = a.row(y);
+                for (int x = 0; x < w; ++x) {
+                    bool wall = (bits[x / BitGrid::word_bits] >> (x % BitGrid::word_bits)) & 1;
+                    row[x] = wall ? TileType::Wall : TileType::Empty;
+                }
+            }
+        }
+};
+
+// Random walk carving until a share of the map is open. Connected by
+// construction, gives winding organic tunnels.
+class DrunkardGenerator : public Generator {
+    private:
+        // Share of open cells to reach, in percent
+        int m_open_percent;
+
+    public:
+        explicit DrunkardGenerator(int open_percent = 35) : m_open_percent { open_percent } { }
+
+        void generate(Grid<TileType> &tiles, rng::Rng &rng) const override {
+            int w = tiles.get_w();
+            int h = tiles.get_h();
+            if (w < 3 || h < 3) {
+                return;
+            }
+
+            auto target = static_cast<long>(w - 2) * (h - 2) * m_open_percent / 100;
+            long open = 0;
+            int x = w / 2;
+            int y = h / 2;
+
+            const int dx[4] = { 1, -1, 0, 0 };
+            const int dy[4] = { 0, 0, 1, -1 };
+            while (open < target) {
+                if (tiles.get(x, y) == TileType::Wall) {
+                    tiles.set(x, y, TileType::Empty);
+                    ++open;
+                }
+
+                auto d = rng.bounded(4);
+                x = std::clamp(x + dx[d], 1, w - 2);
+                y = std::clamp(y + dy[d], 1, h - 2);
+            }
+        }
+};
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include <assert.h>
+
+enum TileType : std::uint8_t
+{
+    Wall,
+    StairsDown,
+    StairsUp,
+    Empty,
+};
+
+// Contiguous row-major 2D buffer. at() is bounds checked and throws,
+// get()/set() are not and are meant for scans that already clipped
+// their range against the grid.
+template <typename T>
+class Grid {
+    private:
+        int m_width = 0;
+        int m_height = 0;
+        std::vector<T> m_cells;
+
+    public:
+        Grid() {};
+        explicit Grid(int w, int h, T value = T {})
+        : m_width { w }, m_height { h }, m_cells(static_cast<std::size_t>(w) * h, value)
+        { }
+
+        int get_w() const { return m_width; }
+        int get_h() const { return m_height; }
+
+        bool in_bounds(int x, int y) const
+        {
+            return x >= 0 && y >= 0 && x < m_width && y < m_height;
+        }
+
+        std::size_t index(int x, int y) const
+        {
+            return static_cast<std::size_t>(y) * m_width + x;
+        }
+
+        T at(int x, int y) const
+        {
+            if (!in_bounds(x, y)) throw std::out_of_range("Grid coordinates out of range");
+            return m_cells[index(x, y)];
+        }
+
+        T get(int x, int y) const
+        {
+            assert(in_bounds(x, y));
+            return m_cells[index(x, y)];
+        }
+
+        void set(int x, int y, T value)
+        {
+            assert(in_bounds(x, y));
+            m_cells[index(x, y)] = value;
+        }
+
+        void fill(T value) { std::fill(m_cells.begin(), m_cells.end(), value); }
+
+        // Cells of row y, for tight scans
+        T* row(int y) { return m_cells.data() + index(0, y); }
+        const T* row(int y) const { return m_cells.data() + index(0, y); }
+
+        T* data() { return m_cells.data(); }
+        const T* data() const { return m_cells.data(); }
+        std::size_t size() const { return m_cells.size(); }
+};
+
+// One bit per cell, row-major, packed into 64 bit words. Rows are padded
+// to whole words so every row starts on a word boundary.
+class BitGrid {
+    public:
+        using Word = std::uint64_t;
+        static constexpr int word_bits = 64;
+
+    private:
+        int m_width = 0;
+        int m_height = 0;
+        int m_row_words = 0;
+        std::vector<Word> m_words;
+
+    public:
+        BitGrid() {};
+        explicit BitGrid(int w, int h)
+        : m_width { w }, m_height { h },
+          m_row_words { (w + word_bits - 1) / word_bits },
+          m_words(static_cast<std::size_t>(m_row_words) * h, 0)
+        { }
+
+        int get_w() const { return m_width; }
+        int get_h() const { return m_height; }
+        int row_words() const { return m_row_words; }
+
+        bool in_bounds(int x, int y) const
+        {
+            return x >= 0 && y >= 0 && x < m_width && y < m_height;
+        }
+
+        bool at(int x, int y) const
+        {
+            if (!in_bounds(x, y)) throw std::out_of_range("BitGrid coordinates out of range");
+            return test(x, y);
+        }
+
+        bool test(int x, int y) const
+        {
+            assert(in_bounds(x, y));
+            return (m_words[word_index(x, y)] >> (x % word_bits)) & 1;
+        }
+
+        void set(int x, int y)
+        {
+            assert(in_bounds(x, y));
+            m_words[word_index(x, y)] |= Word { 1 } << (x % word_bits);
+        }
+
+        void reset(int x, int y)
+        {
+            assert(in_bounds(x, y));
+            m_words[word_index(x, y)] &= ~(Word { 1 } << (x % word_bits));
+        }
+
+        void clear() { std::fill(m_words.begin(), m_words.end(), 0); }
+
+        // ORs `other` into this grid over the whole words covering columns
+        // [x0, x1) of rows [y0, y1). Both grids must have the same size.
+        void merge(const BitGrid &other, int x0, int y0, int x1, int y1)
+        {
+            assert(other.m_width == m_width && other.m_height == m_height);
+
+            x0 = std::max(0, x0);
+            y0 = std::max(0, y0);
+            x1 = std::min(m_width, x1);
+            y1 = std::min(m_height, y1);
+            if (x0 >= x1 || y0 >= y1) return;
+
+            int w0 = x0 / word_bits;
+            int w1 = (x1 - 1) / word_bits + 1;
+            for (int y = y0; y < y1; ++y)
+            {
+                auto dst = row(y);
+                auto src = other.row(y);
+                for (int w = w0; w < w1; ++w) dst[w] |= src[w];
+            }
+        }
+
+        // Number of set bits
+        std::size_t count() const
+        {
+            std::size_t n = 0;
+            for (auto w : m_words) n += std::popcount(w);
+            return n;
+        }
+
+        // Number of set bits in row y between columns `from` and `to`
+        std::size_t count(int y, int from, int to) const
+        {
+            std::size_t n = 0;
+            each_word(y, from, to, [&](int, Word w) { n += std::popcount(w); return true; });
+            return n;
+        }
+
+        // Column of the n-th (from 0) set bit in row y between `from` and
+        // `to`, -1 if there are not that many
+        int nth(int y, int from, int to, std::size_t n) const
+        {
+            int found = -1;
+            each_word(y, from, to, [&](int base, Word w) {
+                std::size_t c = std::popcount(w);
+                if (n >= c)
+                {
+                    n -= c;
+                    return true;
+                }
+                for (; n > 0; --n) w &= w - 1;
+                found = base + std::countr_zero(w);
+                return false;
+            });
+            return found;
+        }
+
+        // Calls fn(x0, x1) for every run of set bits [x0, x1) in row y
+        // between columns `from` and `to`
+        template <typename F>
+        void each_span(int y, int from, int to, F&& fn) const
+        {
+            from = std::max(0, from);
+            to = std::min(m_width, to);
+            if (from >= to) return;
+
+            auto words = row(y);
+            int x = from;
+            while (x < to)
+            {
+                // Skip to the next set bit
+                Word w = words[x / word_bits] >> (x % word_bits);
+                if (w == 0)
+                {
+                    x = (x / word_bits + 1) * word_bits;
+                    continue;
+                }
+                x += std::countr_zero(w);
+                if (x >= to) break;
+
+                // Find where the run ends
+                int start = x;
+                for (;;)
+                {
+                    Word rest = ~words[x / word_bits] >> (x % word_bits);
+                    int run = rest == 0 ? word_bits - x % word_bits : std::countr_zero(rest);
+                    x += run;
+                    if (rest != 0 || x >= to) break;
+                }
+
+                fn(start, std::min(x, to));
+            }
+        }
+
+        Word* row(int y) { return m_words.data() + static_cast<std::size_t>(y) * m_row_words; }
+        const Word* row(int y) const { return m_words.data() + static_cast<std::size_t>(y) * m_row_words; }
+
+        Word* data() { return m_words.data(); }
+        const Word* data() const { return m_words.data(); }
+        std::size_t size() const { return m_words.size(); }
+
+    private:
+        std::size_t word_index(int x, int y) const
+        {
+            return static_cast<std::size_t>(y) * m_row_words + x / word_bits;
+        }
+
+        // Calls fn(first_column, word) for the words of row y masked to
+        // [from, to) until fn returns false
+        template <typename F>
+        void each_word(int y, int from, int to, F&& fn) const
+        {
+            from = std::max(0, from);
+            to = std::min(m_width, to);
+            if (from >= to) return;
+
+            auto words = row(y);
+            int w0 = from / word_bits;
+            int w1 = (to - 1) / word_bits;
+            for (int w = w0; w <= w1; ++w)
+            {
+                Word word = words[w];
+                if (w == w0) word &= ~Word { 0 } << (from % word_bits);
+                if (w == w1 && to % word_bits != 0) word &= ~(~Word { 0 } << (to % word_bits));
+                if (!fn(w * word_bits, word)) return;
+            }
+        }
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "../geometry.hpp"
+#include "map.hpp"
+#include "fov.hpp"
+#include "lighting.hpp"
+#include "generators.hpp"
+#include "chunked_map.hpp"
+
+struct LevelSpec {
+    // Size of the window of the world kept as a Map, see window_size
+    int width;
+    int height;
+    int enemies;
+    int light_radius;
+    int enemy_light_radius;
+    LightColor enemy_light;
+    // Must outlive the level, RoomsGenerator when null
+    const Generator *generator = nullptr;
+};
+
+struct EnemySpawn {
+    Vector2D pos;
+    // Already registered with the level's Lighting
+    LightId light;
+};
+
+// Everything needed to enter a level. Built by generate_level, which
+// only touches its own state and can run on any thread.
+// A level is an unbounded ChunkedMap; `map` is the window of it starting at
+// world cell `origin`, which FOV, lighting, pathing and drawing run on. All
+// positions in here are relative to the window.
+struct Level {
+    std::unique_ptr<ChunkedMap> world;
+    Vector2D origin { 0, 0 };
+    std::unique_ptr<Map> map;
+    Vector2D start { 0, 0 };
+    std::vector<EnemySpawn> enemies;
+};
+
+// Whole chunks covering `playfield` cells with a chunk to spare on both
+// sides, so the camera never reaches the window's edge
+inline int window_size(int playfield) {
+    return ((playfield + Chunk::size - 1) / Chunk::size + 2) * Chunk::size;
+}
+
+// Top left world cell of the window which has `cell`'s chunk in its middle
+inline Vector2D window_origin(Vector2D cell, int width, int height) {
+    auto c = ChunkedMap::chunk_of(cell);
+    return Vector2D { (c.x - width / Chunk::size / 2) * Chunk::size, (c.y - height / Chunk::size / 2) * Chunk::size };
+}
+
+// Resident radius which has the next window loaded before the player
+// crosses into a neighbouring chunk
+inline int window_radius(int width, int height) {
+    return std::max(width, height) / Chunk::size / 2 + 1;
+}
+
+// Copies the window at `origin` out of the world, with what was explored
+// there. The chunks it covers should be resident, others read as walls.
+inline std::unique_ptr<Map> load_window(const ChunkedMap &world, Vector2D origin, int width, int height, std::uint64_t seed) {
+    Rect region;
+    region.x0 = origin.x;
+    region.y0 = origin.y;
+    region.x1 = origin.x + width;
+    region.y1 = origin.y + height;
+
+    Grid<TileType> tiles { width, height, TileType::Wall };
+    world.copy_region(region, tiles);
+    auto map = std::make_unique<Map>(std::move(tiles), seed);
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            if (world.memoized(origin.x + x, origin.y + y)) {
+                map->memoize(x, y);
+            }
+        }
+    }
+    return map;
+}
+
+// Writes the window's explored cells back to the world
+inline void store_window(ChunkedMap &world, Vector2D origin, const Map &map) {
+    for (int y = 0; y < map.get_h(); ++y) {
+        map.memoized().each_span(y, 0, map.get_w(), [&](int x0, int x1) {
+            for (int x = x0; x < x1; ++x) {
+                world.memoize(origin.x + x, origin.y + y);
+            }
+        });
+    }
+}
+
+// Sets up the world around its first chunk and cuts the first window: the
+// player starts on that chunk's hub, enemies on distinct empty cells of
+// the window. Also precomputes the player's sight and the enemies' lights.
+// Changed chunks are paged to a directory of the system's temporary one,
+// private to this process and emptied first, so neither another instance
+// nor a crashed run replayed with the same seed can feed it stale pages.
+inline Level generate_level(const LevelSpec &spec, std::uint64_t seed, const Fov &fov) {
+    static const RoomsGenerator rooms;
+    auto pages = std::filesystem::temp_directory_path()
+        / ("turbo-potato-" + std::to_string(::getpid()) + "-" + std::to_string(seed));
+    std::error_code error;
+    std::filesystem::remove_all(pages, error);
+
+    Level level;
+    level.world = std::make_unique<ChunkedMap>(seed, spec.generator ? *spec.generator : rooms,
+            window_radius(spec.width, spec.height), pages.string());
+
+    auto start = ChunkedMap::hub(ChunkCoord { 0, 0 });
+    level.origin = window_origin(start, spec.width, spec.height);
+    level.world->focus(start);
+    level.world->wait();
+
+    level.map = load_window(*level.world, level.origin, spec.width, spec.height, seed);
+    auto &map = *level.map;
+    level.start = start - level.origin;
+
+    // One draw without replacement, minus the start if it came up, so no
+    // enemy starts on the player or on another enemy
+    auto spots = map.get_random_empty_coords(static_cast<std::size_t>(spec.enemies) + 1);
+    spots.erase(std::remove(spots.begin(), spots.end(), level.start), spots.end());
+    spots.resize(std::min(spots.size(), static_cast<std::size_t>(spec.enemies)));
+
+    level.enemies.reserve(spots.size());
+    for (auto pos : spots) {
+        level.enemies.push_back(EnemySpawn { pos, map.lighting().add(pos, spec.enemy_light_radius, spec.enemy_light) });
+    }
+
+    map.update_light(fov, level.start, spec.light_radius);
+    map.update_lighting(fov);
+
+    return level;
+}
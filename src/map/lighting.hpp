@@ -0,0 +1,254 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "../geometry.hpp"
+#include "grid.hpp"
+#include "fov.hpp"
+
+struct LightColor {
+    std::uint8_t r = 0;
+    std::uint8_t g = 0;
+    std::uint8_t b = 0;
+};
+
+using LightId = std::uint32_t;
+constexpr LightId invalidLight = ~0u;
+
+// Any number of point lights blended additively into an RGB buffer.
+// Every light keeps its own visibility, just the (2r+1)^2 box it can
+// reach, and a falloff kernel premultiplied by its colour, so memory grows
+// with lights * r^2 and not with the map. Its contribution stays in 32 bit per
+// channel accumulators, so moving a light subtracts the old contribution
+// and adds the new one without touching other lights; only the union of
+// the boxes that changed is resolved into the 8 bit output. Sums are exact
+// (clamping them would break the subtraction) and cannot wrap below 16M
+// overlapping full brightness lights.
+class Lighting {
+    private:
+        struct Source {
+            Vector2D pos { 0, 0 };
+            int radius = 0;
+            LightColor color;
+            // Visibility in the box around `lit_pos` where it was last
+            // computed, bit (0, 0) is lit_pos - (radius, radius)
+            BitGrid visible;
+            Vector2D lit_pos { 0, 0 };
+            bool stale = true;
+            // (2r+1)^2 falloff * colour, one plane per channel
+            std::vector<std::uint16_t> kernel[3];
+            bool applied = false;
+            bool alive = false;
+        };
+
+        int m_width;
+        int m_height;
+        LightColor m_ambient;
+        Grid<std::uint32_t> m_acc[3];
+        Grid<LightColor> m_resolved;
+        std::vector<Source> m_sources;
+        std::vector<LightId> m_free;
+
+        // Box which needs resolving, empty when x0 >= x1
+        int m_dirty_x0 = 0;
+        int m_dirty_y0 = 0;
+        int m_dirty_x1 = 0;
+        int m_dirty_y1 = 0;
+
+        static void build_kernel(Source &s) {
+            int r = s.radius;
+            int side = 2 * r + 1;
+            int falloff = (r + 1) * (r + 1);
+            std::uint8_t color[3] = { s.color.r, s.color.g, s.color.b };
+
+            for (int c = 0; c < 3; ++c) {
+                s.kernel[c].assign(static_cast<std::size_t>(side) * side, 0);
+            }
+
+            for (int dy = -r; dy <= r; ++dy) {
+                for (int dx = -r; dx <= r; ++dx) {
+                    int d2 = dx * dx + dy * dy;
+                    if (d2 > r * r) {
+                        continue;
+                    }
+
+                    // Quadratic falloff, full strength at the source
+                    int f = 255 * (falloff - d2) / falloff;
+                    auto i = static_cast<std::size_t>(dy + r) * side + (dx + r);
+                    for (int c = 0; c < 3; ++c) {
+                        s.kernel[c][i] = static_cast<std::uint16_t>(color[c] * f / 255);
+                    }
+                }
+            }
+        }
+
+        void mark_dirty(Vector2D origin, int radius) {
+            int x0 = std::max(0, origin.x - radius);
+            int y0 = std::max(0, origin.y - radius);
+            int x1 = std::min(m_width, origin.x + radius + 1);
+            int y1 = std::min(m_height, origin.y + radius + 1);
+
+            if (m_dirty_x0 >= m_dirty_x1) {
+                m_dirty_x0 = x0; m_dirty_y0 = y0; m_dirty_x1 = x1; m_dirty_y1 = y1;
+                return;
+            }
+
+            m_dirty_x0 = std::min(m_dirty_x0, x0);
+            m_dirty_y0 = std::min(m_dirty_y0, y0);
+            m_dirty_x1 = std::max(m_dirty_x1, x1);
+            m_dirty_y1 = std::max(m_dirty_y1, y1);
+        }
+
+        // Adds (or subtracts) the source's current contribution. The inner
+        // loops are branch free so they vectorize.
+        template <bool add>
+        void apply(const Source &s) {
+            auto origin = s.lit_pos;
+            int r = s.radius;
+            int side = 2 * r + 1;
+
+            int x0 = std::max(0, origin.x - r);
+            int y0 = std::max(0, origin.y - r);
+            int x1 = std::min(m_width, origin.x + r + 1);
+            int y1 = std::min(m_height, origin.y + r + 1);
+
+            for (int y = y0; y < y1; ++y) {
+                auto row = static_cast<std::size_t>(y - origin.y + r) * side;
+                auto bits = s.visible.row(y - origin.y + r);
+                int kx = origin.x - r;
+
+                for (int c = 0; c < 3; ++c) {
+                    auto acc = m_acc[c].row(y);
+                    auto kernel = s.kernel[c].data() + row;
+
+                    for (int x = x0; x < x1; ++x) {
+                        int bx = x - kx;
+                        auto lit = static_cast<std::uint32_t>(-static_cast<int>((bits[bx / BitGrid::word_bits] >> (bx % BitGrid::word_bits)) & 1));
+                        auto v = kernel[x - kx] & lit;
+                        if constexpr (add) {
+                            acc[x] += v;
+                        } else {
+                            acc[x] -= v;
+                        }
+                    }
+                }
+            }
+
+            mark_dirty(origin, r);
+        }
+
+        void resolve() {
+            for (int y = m_dirty_y0; y < m_dirty_y1; ++y) {
+                auto out = m_resolved.row(y);
+                auto r = m_acc[0].row(y);
+                auto g = m_acc[1].row(y);
+                auto b = m_acc[2].row(y);
+
+                for (int x = m_dirty_x0; x < m_dirty_x1; ++x) {
+                    out[x].r = static_cast<std::uint8_t>(std::min<std::uint32_t>(255, m_ambient.r + r[x]));
+                    out[x].g = static_cast<std::uint8_t>(std::min<std::uint32_t>(255, m_ambient.g + g[x]));
+                    out[x].b = static_cast<std::uint8_t>(std::min<std::uint32_t>(255, m_ambient.b + b[x]));
+                }
+            }
+
+            m_dirty_x0 = m_dirty_x1 = 0;
+        }
+
+    public:
+        explicit Lighting(int w, int h, LightColor ambient = LightColor {})
+        : m_width { w }, m_height { h }, m_ambient { ambient },
+          m_acc { Grid<std::uint32_t> { w, h }, Grid<std::uint32_t> { w, h }, Grid<std::uint32_t> { w, h } },
+          m_resolved { w, h, ambient }
+        { }
+
+        LightId add(Vector2D pos, int radius, LightColor color) {
+            LightId id;
+            if (!m_free.empty()) {
+                id = m_free.back();
+                m_free.pop_back();
+            } else {
+                id = static_cast<LightId>(m_sources.size());
+                m_sources.emplace_back();
+            }
+
+            auto &s = m_sources[id];
+            int side = 2 * radius + 1;
+            if (s.visible.get_w() != side) {
+                s.visible = BitGrid { side, side };
+            }
+            s.stale = true;
+            s.pos = pos;
+            s.radius = radius;
+            s.color = color;
+            s.applied = false;
+            s.alive = true;
+            build_kernel(s);
+
+            return id;
+        }
+
+        void move(LightId id, Vector2D pos) {
+            m_sources[id].pos = pos;
+        }
+
+        void remove(LightId id) {
+            auto &s = m_sources[id];
+            if (s.applied) {
+                apply<false>(s);
+            }
+            s.applied = false;
+            s.alive = false;
+            m_free.push_back(id);
+        }
+
+        std::size_t size() const { return m_sources.size() - m_free.size(); }
+
+        // Lights which could reach (x, y) get recomputed on the next update
+        void tile_changed(int x, int y) {
+            for (auto &s : m_sources) {
+                if (s.alive && std::abs(x - s.lit_pos.x) <= s.radius && std::abs(y - s.lit_pos.y) <= s.radius) {
+                    s.stale = true;
+                }
+            }
+        }
+
+        // Recomputes lights that moved, were added, or whose surroundings
+        // changed, then resolves the touched area. Returns whether any cell
+        // was resolved.
+        bool update(const Fov &fov, const Grid<TileType> &map) {
+            for (auto &s : m_sources) {
+                if (!s.alive || (s.applied && !s.stale && s.pos == s.lit_pos)) {
+                    continue;
+                }
+
+                if (s.applied) {
+                    apply<false>(s);
+                }
+                s.visible.clear();
+                fov.compute(map, s.pos, s.radius, s.visible, s.pos - Vector2D { s.radius, s.radius });
+                s.lit_pos = s.pos;
+                s.stale = false;
+                apply<true>(s);
+                s.applied = true;
+            }
+
+            if (m_dirty_x0 >= m_dirty_x1) {
+                return false;
+            }
+            resolve();
+            return true;
+        }
+
+        LightColor color(int x, int y) const { return m_resolved.at(x, y); }
+
+        // Brightest channel, 0 is pitch black
+        std::uint8_t intensity(int x, int y) const {
+            auto c = m_resolved.at(x, y);
+            return std::max(c.r, std::max(c.g, c.b));
+        }
+
+        const Grid<LightColor>& colors() const { return m_resolved; }
+};
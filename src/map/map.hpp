@@ -4,6 +4,7 @@
 #include <vector>
 #include <utility>
 #include <memory>
+#include <optional>
 #include <math.h>
 #include <unordered_map>
 #include <assert.h>
@@ -11,198 +12,155 @@
 #include "../random.hpp"
 #include "../logging.hpp"
 #include "../geometry.hpp"
+#include "grid.hpp"
+#include "fov.hpp"
+#include "lighting.hpp"
+#include "cell_index.hpp"
+#include "generators.hpp"
 
-enum TileType
-{
-    Wall,
-    StairsDown,
-    StairsUp,
-    Empty,
-};
-
-class Tile
-{
-    public:
-        explicit Tile(TileType t): m_type { t } { };
-        TileType m_type = TileType::Empty;
-        bool m_memoized = false;
-    private:
-};
-
-const Tile wall_tile { TileType::Wall };
-
-enum LightLevel {
-    Invisible,
-    Dim,
-    Visible
-};
-
-class LightMap {
+class Map {
     private:
-        std::vector<std::vector<LightLevel>> light_map;
-
-        // Implementation based on this pseudo code http://www.roguebasin.com/index.php?title=Eligloscode
-        void calc_fov(float x, float y, int w, int h, Vector2D camera_pos, const std::vector<std::vector<Tile>> &map, int light_radius) {
-            int i, tx, ty;
-            float ox, oy;
-            ox = static_cast<float>(camera_pos.x) + 0.5f;
-            oy = static_cast<float>(camera_pos.y) + 0.5f;
-
-            for (i = 0; i < light_radius; ++i) {
-                tx = static_cast<int>(ox);
-                ty = static_cast<int>(oy);
-
-                if (!(tx >= 0 && tx <= w && ty >= 0 && ty <= h)) {
-                    return;
-                }
-
-                light_map[tx][ty] = LightLevel::Visible;
+        int width;
+        int height;
+        // Generation and sampling only use this, so maps can be built on
+        // any thread and a seed always gives the same map
+        rng::Rng m_rng;
+        Grid<TileType> m_tiles;
+        BitGrid m_memoized;
+        LightMap m_light;
+        Lighting m_lighting;
+        // Every TileType::Empty cell
+        CellIndex m_empty;
+        // Bumped by every set_tile inside the block, lets caches built from
+        // the tiles (e.g. baked textures) rebuild only what changed
+        Grid<std::uint32_t> m_block_revisions;
+        std::uint32_t m_shade_revision = 0;
 
-                if (map[tx][ty].m_type == TileType::Wall) {
-                    return;
-                }
+        void add_stairs(Vector2D pos) {
+            logger::info("Generated stairs at", pos.x, pos.y);
+            set_tile(pos.x, pos.y, TileType::StairsDown);
+        }
 
-                ox += x;
-                oy += y;
-            }
+        void generate_maze(const Generator &generator) {
+            generator.generate(m_tiles, m_rng);
+            m_empty.build(m_tiles, [](TileType t) { return t == TileType::Empty; });
+            add_stairs(get_random_empty_coords());
         }
+
     public:
-        LightMap() {};
-        explicit LightMap(Vector2D camera_pos, int w, int h, const std::vector<std::vector<Tile>> &map, float light_radius)
-        : light_map { std::vector<std::vector<LightLevel>>(w, std::vector<LightLevel>(h, LightLevel::Dim)) }
+        static constexpr int block_size = 16;
+
+        explicit Map(int w, int h, std::uint64_t seed, const Generator &generator) :
+            width { w },
+            height { h },
+            m_rng { seed },
+            m_tiles { w, h, TileType::Wall },
+            m_memoized { w, h },
+            m_light { w, h },
+            m_lighting { w, h },
+            m_empty { w, h },
+            m_block_revisions { (w + block_size - 1) / block_size, (h + block_size - 1) / block_size, 0 }
         {
-            float x, y, fi;
+            logger::info("Generating maze");
+            generate_maze(generator);
+        }
 
-            for (int i = 0; i < 360; ++i) {
-                fi = static_cast<float>(i);
-                x = cos(fi*0.01745f);
-                y = sin(fi*0.01745f);
+        explicit Map(int w, int h, std::uint64_t seed) : Map(w, h, seed, RoomsGenerator {}) { }
+
+        // Over ready made tiles, e.g. a window cut out of a ChunkedMap. No
+        // stairs are added.
+        explicit Map(Grid<TileType> tiles, std::uint64_t seed) :
+            width { tiles.get_w() },
+            height { tiles.get_h() },
+            m_rng { seed },
+            m_tiles { std::move(tiles) },
+            m_memoized { width, height },
+            m_light { width, height },
+            m_lighting { width, height },
+            m_empty { width, height },
+            m_block_revisions { (width + block_size - 1) / block_size, (height + block_size - 1) / block_size, 0 }
+        {
+            m_empty.build(m_tiles, [](TileType t) { return t == TileType::Empty; });
+        }
 
-                calc_fov(x, y, w, h, camera_pos, map, light_radius);
+        const int get_w() const { return width; }
+        const int get_h() const { return height; }
+        const Grid<TileType>& tiles() const { return m_tiles; }
+
+        // Bounds checked, throws std::out_of_range
+        TileType at(int x, int y) const { return m_tiles.at(x, y); }
+        // Unchecked, for scans clipped to the map
+        TileType get(int x, int y) const { return m_tiles.get(x, y); }
+
+        // Cells the player has seen at some point on this level
+        bool memoized(int x, int y) const { return m_memoized.at(x, y); }
+        const BitGrid& memoized() const { return m_memoized; }
+        // For explored state carried over from elsewhere
+        void memoize(int x, int y) { m_memoized.set(x, y); ++m_shade_revision; }
+        std::size_t memoized_count() const { return m_memoized.count(); }
+        float memoized_ratio() const { return static_cast<float>(memoized_count()) / (width * height); }
+
+        // Tile edits after generation go through here so the light map
+        // notices them
+        void set_tile(int x, int y, TileType type) {
+            m_tiles.set(x, y, type);
+            if (type == TileType::Empty) {
+                m_empty.insert(x, y);
+            } else {
+                m_empty.erase(x, y);
             }
-        };
-
-        bool visible(int x, int y) {
-            return light_level(x, y) == LightLevel::Visible;
+            m_light.tile_changed(x, y);
+            m_lighting.tile_changed(x, y);
+            m_block_revisions.row(y / block_size)[x / block_size] += 1;
         }
 
-        LightLevel light_level(int x, int y) {
-            assert(x < light_map.size());
-            assert(y < light_map[x].size());
-            return light_map[x][y];
-        };
-};
+        std::uint32_t block_revision(int bx, int by) const { return m_block_revisions.get(bx, by); }
 
-class Map {
-    private:
-        int width;
-        int height;
-        std::vector<std::vector<Tile>> map;
-        int nrect = rng::gen_int(12, 26);
-        std::vector<Rect> rects;
-
-        Rect gen_rect(int size_w_limit, int size_h_limit) {
-            int size_w = rng::gen_int(3, size_w_limit);
-            int size_h = rng::gen_int(3, size_h_limit);
-            Rect rect;
-
-            // start of rect can be anywhere on screen
-            rect.x0 = rng::gen_int(0, width-size_w);
-            rect.y0 = rng::gen_int(0, height-size_h);
-            // add size to starting point
-            rect.x1 = rect.x0 + size_w;
-            rect.y1 = rect.y0 + size_h;
-
-            return rect;
-        }
+        const LightMap& light() const { return m_light; }
 
-        void render(Rect rect) {
-            // renders the rectangle on the map
-            for (int x = rect.x0; x < rect.x1; ++x) {
-                for (int y = rect.y0; y < rect.y1; ++y) {
-                    map[x][y].m_type = TileType::Empty;
-                }
+        // O(radius^2); free when neither origin nor nearby tiles changed.
+        // Everything visible afterwards is memoized in one OR per row word.
+        // Returns whether anything was recomputed.
+        bool update_light(const Fov &fov, Vector2D origin, int radius) {
+            if (!m_light.compute(fov, m_tiles, origin, radius)) {
+                return false;
             }
+
+            m_memoized.merge(m_light.cells(), origin.x - radius, origin.y - radius, origin.x + radius + 1, origin.y + radius + 1);
+            ++m_shade_revision;
+            return true;
         }
 
-        void add_tunnel_to_existing(Rect new_rect) {
-            if (rects.size() > 0) {
-                // Decide which rectangle to connect to
-                // Rect rect = existing_rects[rng::gen_int(0, existing_rects.size()) - 1]; // FIXATSOMEPOINT: segfaults
-                Rect rect = rects.back();
-
-                // Calculate centers and sort
-                int centers_x[2] = { center_x(new_rect), center_x(rect) };
-                int centers_y[2] = { center_y(new_rect), center_y(rect) };
-                // hacky fix this is needed to handle different types of elbows -| and |-
-                int tunnel_y_x_index = ((centers_x[0] > centers_x[1]) && (centers_y[0] > centers_y[1])) ? 1 : 0;
-                if (centers_x[0] > centers_x[1])
-                    std::swap(centers_x[0], centers_x[1]);
-                if (centers_y[0] > centers_y[1])
-                    std::swap(centers_y[0], centers_y[1]);
-
-                // Make the horizontal part of the tunnel
-                Rect tunnel_x;
-                tunnel_x.x0 = centers_x[0];
-                tunnel_x.y0 = centers_y[0]-1;
-                tunnel_x.x1 = centers_x[1];
-                tunnel_x.y1 = centers_y[0]+1;
-                render(tunnel_x);
-                // Make the vertical part of the tunnel
-                Rect tunnel_y;
-                tunnel_y.x0 = centers_x[tunnel_y_x_index] - 1;
-                tunnel_y.y0 = centers_y[0];
-                tunnel_y.x1 = centers_x[tunnel_y_x_index] + 1;
-                tunnel_y.y1 = centers_y[1];
-                render(tunnel_y);
+        Lighting& lighting() { return m_lighting; }
+        const Lighting& lighting() const { return m_lighting; }
+
+        void update_lighting(const Fov &fov) {
+            if (m_lighting.update(fov, m_tiles)) {
+                ++m_shade_revision;
             }
         }
 
-        void add_stairs(Vector2D pos) {
-            logger::info("Generated stairs at", pos.x, pos.y);
-            map[pos.x][pos.y].m_type = TileType::StairsDown;
-        }
+        // Moves whenever what is visible, explored or lit changed
+        std::uint32_t shade_revision() const { return m_shade_revision; }
 
-        void generate_maze() {
-            logger::info("Maze number of rectangles is", nrect);
+        std::size_t empty_count() const { return m_empty.size(); }
 
-            for (int i = 0; i < nrect; ++i) {
-                auto rect = gen_rect(10, 10);
-                // renders the rectangle on the map
-                render(rect);
-                // connects rectangle to existing rectangles
-                add_tunnel_to_existing(rect);
-                rects.push_back(rect);
-            }
-            add_stairs(get_random_empty_coords());
+        // O(1), throws when the map has no empty cell
+        Vector2D get_random_empty_coords()
+        {
+            return m_empty.sample(m_rng);
         }
 
-    public:
-        explicit Map(int w, int h) :
-            width { w },
-            height { h },
-            map { std::vector<std::vector<Tile>>(w, std::vector<Tile>(h, wall_tile)) }
+        // Uniform over the empty cells inside `region`
+        std::optional<Vector2D> get_random_empty_coords(Rect region)
         {
-            logger::info("Generating maze");
-            generate_maze();
+            return m_empty.sample(m_rng, region);
         }
 
-        const int get_w() const { return width; }
-        const int get_h() const { return height; }
-        const TileType at(int x, int y) const { return map[x][y].m_type; }
-        const bool memoized(int x, int y) const { return map[x][y].m_memoized; }
-        void memoize(int x, int y) { map[x][y].m_memoized = true; }
-
-        Vector2D get_random_empty_coords() const
+        // n distinct empty cells for batch spawns, fewer if the map has fewer
+        std::vector<Vector2D> get_random_empty_coords(std::size_t n)
         {
-            int x, y;
-            for (;;) {
-                x = rng::gen_int(0, width);
-                y = rng::gen_int(0, height);
-                if (at(x, y) == TileType::Empty) {
-                    return Vector2D(x, y);
-                }
-            }
+            return m_empty.sample(m_rng, n);
         }
 
         bool can_move(Vector2D pos, MovementDirection direction) const
@@ -226,10 +184,6 @@ class Map {
 
             auto [x, y] = pos;
 
-            return x >= 0 && y >= 0 && x <= width && y <= height && map[x][y].m_type != TileType::Wall;
-        };
-
-        std::unique_ptr<LightMap> generate_light_map(Vector2D camera_pos, int light_radius) {
-            return std::make_unique<LightMap>(camera_pos, width, height, map, light_radius);
+            return m_tiles.in_bounds(x, y) && m_tiles.get(x, y) != TileType::Wall;
         };
 };
@@ -0,0 +1,342 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include <assert.h>
+
+#include "../geometry.hpp"
+#include "grid.hpp"
+
+// Scratch state shared by the searches below. Every query bumps the
+// generation instead of clearing arrays; a cell's slot only counts when its
+// stamp matches the current generation.
+class SearchStamps {
+    private:
+        std::vector<std::uint32_t> m_stamps;
+        std::uint32_t m_generation = 0;
+
+    public:
+        void resize(std::size_t size) {
+            if (m_stamps.size() != size) {
+                m_stamps.assign(size, 0);
+                m_generation = 0;
+            }
+        }
+
+        void next() {
+            if (++m_generation == 0) {
+                std::fill(m_stamps.begin(), m_stamps.end(), 0);
+                m_generation = 1;
+            }
+        }
+
+        bool seen(std::size_t i) const { return m_stamps[i] == m_generation; }
+        void mark(std::size_t i) { m_stamps[i] = m_generation; }
+};
+
+// A* with Jump Point Search for single queries on the 4-connected grid
+// (walls block, everything else costs 1). Straight runs are skipped in one
+// go and only turning points get into the open list. The open list and all
+// per-cell arrays are kept between queries, so after the first few queries
+// on a map size nothing is allocated.
+class Pathfinder {
+    private:
+        struct Node {
+            int f;
+            int g;
+            int cell;
+
+            // Min heap on f, preferring deeper nodes on ties
+            bool operator<(const Node &o) const { return f != o.f ? f > o.f : g < o.g; }
+        };
+
+        int m_width = 0;
+        int m_height = 0;
+        const Grid<TileType> *m_map = nullptr;
+        Vector2D m_goal { 0, 0 };
+
+        SearchStamps m_touched;
+        SearchStamps m_closed;
+        std::vector<int> m_g;
+        std::vector<int> m_parent;
+        std::vector<Node> m_open;
+
+        bool walkable(int x, int y) const {
+            return m_map->in_bounds(x, y) && m_map->get(x, y) != TileType::Wall;
+        }
+
+        int cell(int x, int y) const { return y * m_width + x; }
+        int heuristic(int x, int y) const { return std::abs(x - m_goal.x) + std::abs(y - m_goal.y); }
+
+        // Horizontal runs stop at the goal or where a wall behind them opens
+        // up above or below
+        int jump_horizontal(int x, int y, int dx) const {
+            for (;;) {
+                x += dx;
+                if (!walkable(x, y)) {
+                    return -1;
+                }
+                if ((x == m_goal.x && y == m_goal.y) ||
+                        (walkable(x, y - 1) && !walkable(x - dx, y - 1)) ||
+                        (walkable(x, y + 1) && !walkable(x - dx, y + 1))) {
+                    return cell(x, y);
+                }
+            }
+        }
+
+        // Vertical runs also stop wherever a horizontal run from them finds
+        // a jump point
+        int jump_vertical(int x, int y, int dy) const {
+            for (;;) {
+                y += dy;
+                if (!walkable(x, y)) {
+                    return -1;
+                }
+                if ((x == m_goal.x && y == m_goal.y) ||
+                        (walkable(x - 1, y) && !walkable(x - 1, y - dy)) ||
+                        (walkable(x + 1, y) && !walkable(x + 1, y - dy)) ||
+                        jump_horizontal(x, y, 1) >= 0 || jump_horizontal(x, y, -1) >= 0) {
+                    return cell(x, y);
+                }
+            }
+        }
+
+        void push(int to, int g) {
+            if (m_touched.seen(to) && m_g[to] <= g) {
+                return;
+            }
+            m_touched.mark(to);
+            m_g[to] = g;
+            m_open.push_back(Node { g + heuristic(to % m_width, to / m_width), g, to });
+            std::push_heap(m_open.begin(), m_open.end());
+        }
+
+        void expand(int from) {
+            int x = from % m_width;
+            int y = from / m_width;
+            int g = m_g[from];
+
+            // Directions worth trying given where we came from
+            int dirs[4][2];
+            int n = 0;
+            if (m_parent[from] < 0) {
+                dirs[n][0] = 1; dirs[n++][1] = 0;
+                dirs[n][0] = -1; dirs[n++][1] = 0;
+                dirs[n][0] = 0; dirs[n++][1] = 1;
+                dirs[n][0] = 0; dirs[n++][1] = -1;
+            } else {
+                int px = m_parent[from] % m_width;
+                int py = m_parent[from] / m_width;
+                int dx = (x > px) - (x < px);
+                int dy = (y > py) - (y < py);
+                if (dx != 0) {
+                    dirs[n][0] = dx; dirs[n++][1] = 0;
+                    dirs[n][0] = 0; dirs[n++][1] = 1;
+                    dirs[n][0] = 0; dirs[n++][1] = -1;
+                } else {
+                    dirs[n][0] = 0; dirs[n++][1] = dy;
+                    dirs[n][0] = 1; dirs[n++][1] = 0;
+                    dirs[n][0] = -1; dirs[n++][1] = 0;
+                }
+            }
+
+            for (int i = 0; i < n; ++i) {
+                int to = dirs[i][1] == 0 ? jump_horizontal(x, y, dirs[i][0]) : jump_vertical(x, y, dirs[i][1]);
+                if (to < 0 || m_closed.seen(to)) {
+                    continue;
+                }
+
+                int g_to = g + std::abs(to % m_width - x) + std::abs(to / m_width - y);
+                if (!m_touched.seen(to) || g_to < m_g[to]) {
+                    m_parent[to] = from;
+                }
+                push(to, g_to);
+            }
+        }
+
+    public:
+        Pathfinder() {};
+        explicit Pathfinder(int w, int h) { resize(w, h); }
+
+        void resize(int w, int h) {
+            m_width = w;
+            m_height = h;
+            auto size = static_cast<std::size_t>(w) * h;
+            m_touched.resize(size);
+            m_closed.resize(size);
+            m_g.resize(size);
+            m_parent.resize(size);
+            m_open.reserve(size);
+        }
+
+        // Fills `path` with the steps from `from` (excluded) to `to`
+        // (included). Returns false, leaving `path` empty, when there is no
+        // way through. Reuse `path` between calls to avoid allocating.
+        bool find_path(const Grid<TileType> &map, Vector2D from, Vector2D to, std::vector<Vector2D> &path) {
+            assert(map.get_w() == m_width && map.get_h() == m_height);
+            path.clear();
+            m_map = &map;
+            m_goal = to;
+
+            if (!walkable(from.x, from.y) || !walkable(to.x, to.y)) {
+                return false;
+            }
+            if (from == to) {
+                return true;
+            }
+
+            m_touched.next();
+            m_closed.next();
+            m_open.clear();
+
+            int start = cell(from.x, from.y);
+            int goal = cell(to.x, to.y);
+            m_parent[start] = -1;
+            push(start, 0);
+
+            while (!m_open.empty()) {
+                std::pop_heap(m_open.begin(), m_open.end());
+                auto node = m_open.back();
+                m_open.pop_back();
+
+                // Stale duplicate of a node improved after it was pushed
+                if (m_closed.seen(node.cell) || node.g != m_g[node.cell]) {
+                    continue;
+                }
+                m_closed.mark(node.cell);
+
+                if (node.cell == goal) {
+                    // Walk the jump points back, filling in the straight
+                    // runs between them
+                    for (int c = goal; c != start; c = m_parent[c]) {
+                        int x = c % m_width;
+                        int y = c / m_width;
+                        int px = m_parent[c] % m_width;
+                        int py = m_parent[c] / m_width;
+                        while (x != px || y != py) {
+                            path.push_back(Vector2D { x, y });
+                            x += (px > x) - (px < x);
+                            y += (py > y) - (py < y);
+                        }
+                    }
+                    std::reverse(path.begin(), path.end());
+                    return true;
+                }
+
+                expand(node.cell);
+            }
+
+            return false;
+        }
+};
+
+// Breadth first distance to the nearest of any number of sources. One
+// compute per turn serves every agent chasing those sources: each one just
+// steps to its lowest neighbour. Unit step costs make Dijkstra a plain BFS,
+// so the queue is a flat array holding each cell at most once.
+class DijkstraMap {
+    private:
+        int m_width = 0;
+        int m_height = 0;
+        SearchStamps m_reached;
+        std::vector<int> m_distance;
+        std::vector<int> m_queue;
+
+        void visit(const Grid<TileType> &map, int x, int y, int distance, std::size_t &tail) {
+            if (!map.in_bounds(x, y) || map.get(x, y) == TileType::Wall) {
+                return;
+            }
+            auto i = map.index(x, y);
+            if (m_reached.seen(i)) {
+                return;
+            }
+            m_reached.mark(i);
+            m_distance[i] = distance;
+            m_queue[tail++] = static_cast<int>(i);
+        }
+
+    public:
+        static constexpr int unreachable = -1;
+
+        DijkstraMap() {};
+        explicit DijkstraMap(int w, int h) { resize(w, h); }
+
+        void resize(int w, int h) {
+            m_width = w;
+            m_height = h;
+            auto size = static_cast<std::size_t>(w) * h;
+            m_reached.resize(size);
+            m_distance.resize(size);
+            m_queue.resize(size);
+        }
+
+        // Cells further than `max_distance` from every source are left
+        // unreachable, which bounds the work to the area that matters
+        template <typename Sources>
+        void compute(const Grid<TileType> &map, const Sources &sources, int max_distance = INT_MAX) {
+            assert(map.get_w() == m_width && map.get_h() == m_height);
+            m_reached.next();
+
+            std::size_t head = 0;
+            std::size_t tail = 0;
+            for (const Vector2D &source : sources) {
+                visit(map, source.x, source.y, 0, tail);
+            }
+
+            while (head < tail) {
+                int i = m_queue[head++];
+                int d = m_distance[i];
+                if (d >= max_distance) {
+                    continue;
+                }
+
+                int x = i % m_width;
+                int y = i / m_width;
+                visit(map, x + 1, y, d + 1, tail);
+                visit(map, x - 1, y, d + 1, tail);
+                visit(map, x, y + 1, d + 1, tail);
+                visit(map, x, y - 1, d + 1, tail);
+            }
+        }
+
+        void compute(const Grid<TileType> &map, Vector2D source, int max_distance = INT_MAX) {
+            Vector2D sources[1] = { source };
+            compute(map, sources, max_distance);
+        }
+
+        int distance(int x, int y) const {
+            if (x < 0 || y < 0 || x >= m_width || y >= m_height) {
+                return unreachable;
+            }
+            auto i = static_cast<std::size_t>(y) * m_width + x;
+            return m_reached.seen(i) ? m_distance[i] : unreachable;
+        }
+
+        // Direction of the neighbour closest to a source, None when `from`
+        // is unreachable, already at a source or hemmed in. Cells set in
+        // `blocked` (e.g. occupied by other agents) are skipped.
+        MovementDirection step(Vector2D from, const BitGrid *blocked = nullptr) const {
+            int best = distance(from.x, from.y);
+            if (best == unreachable) {
+                return MovementDirection::None;
+            }
+
+            auto direction = MovementDirection::None;
+            auto consider = [&](int x, int y, MovementDirection d) {
+                int distance = this->distance(x, y);
+                if (distance != unreachable && distance < best && !(blocked && blocked->test(x, y))) {
+                    best = distance;
+                    direction = d;
+                }
+            };
+
+            consider(from.x, from.y - 1, MovementDirection::Up);
+            consider(from.x, from.y + 1, MovementDirection::Down);
+            consider(from.x - 1, from.y, MovementDirection::Left);
+            consider(from.x + 1, from.y, MovementDirection::Right);
+            return direction;
+        }
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include <assert.h>
+
+#include "../geometry.hpp"
+
+// Items bucketed by block_size² blocks of map cells, for "what is inside
+// this rectangle" queries that only touch the blocks overlapping it.
+// Callers report moves; the grid keeps each item's last known position.
+template <typename T>
+class SpatialGrid {
+    private:
+        struct Entry {
+            T item;
+            Vector2D pos;
+        };
+
+        int m_width = 0;
+        int m_height = 0;
+        int m_blocks_w = 0;
+        int m_blocks_h = 0;
+        std::vector<std::vector<Entry>> m_blocks;
+        std::size_t m_size = 0;
+
+        std::vector<Entry>& block(Vector2D pos) {
+            assert(pos.x >= 0 && pos.y >= 0 && pos.x < m_width && pos.y < m_height);
+            return m_blocks[static_cast<std::size_t>(pos.y / block_size) * m_blocks_w + pos.x / block_size];
+        }
+
+        // Swap-removes `item` from the block of `pos`
+        bool remove(T item, Vector2D pos) {
+            auto& entries = block(pos);
+            auto it = std::find_if(entries.begin(), entries.end(), [&](const Entry& e) { return e.item == item; });
+            if (it == entries.end()) {
+                return false;
+            }
+            *it = entries.back();
+            entries.pop_back();
+            return true;
+        }
+
+    public:
+        static constexpr int block_size = 8;
+
+        SpatialGrid() {};
+        explicit SpatialGrid(int w, int h)
+        : m_width { w }, m_height { h },
+          m_blocks_w { (w + block_size - 1) / block_size },
+          m_blocks_h { (h + block_size - 1) / block_size },
+          m_blocks(static_cast<std::size_t>(m_blocks_w) * m_blocks_h)
+        { }
+
+        std::size_t size() const { return m_size; }
+
+        // Keeps the buckets' capacity
+        void clear() {
+            for (auto& entries : m_blocks) {
+                entries.clear();
+            }
+            m_size = 0;
+        }
+
+        void insert(T item, Vector2D pos) {
+            block(pos).push_back(Entry { item, pos });
+            ++m_size;
+        }
+
+        void erase(T item, Vector2D pos) {
+            if (remove(item, pos)) {
+                --m_size;
+            }
+        }
+
+        void move(T item, Vector2D from, Vector2D to) {
+            auto& entries = block(from);
+            if (&entries == &block(to)) {
+                for (auto& e : entries) {
+                    if (e.item == item) {
+                        e.pos = to;
+                        return;
+                    }
+                }
+            }
+
+            if (remove(item, from)) {
+                block(to).push_back(Entry { item, to });
+            }
+        }
+
+        // Calls fn(item, pos) for every item with x0 <= pos.x < x1 and
+        // y0 <= pos.y < y1
+        template <typename F>
+        void query(int x0, int y0, int x1, int y1, F&& fn) const {
+            x0 = std::max(0, x0);
+            y0 = std::max(0, y0);
+            x1 = std::min(m_width, x1);
+            y1 = std::min(m_height, y1);
+            if (x0 >= x1 || y0 >= y1) {
+                return;
+            }
+
+            for (int by = y0 / block_size; by <= (y1 - 1) / block_size; ++by) {
+                for (int bx = x0 / block_size; bx <= (x1 - 1) / block_size; ++bx) {
+                    for (auto& e : m_blocks[static_cast<std::size_t>(by) * m_blocks_w + bx]) {
+                        if (e.pos.x >= x0 && e.pos.y >= y0 && e.pos.x < x1 && e.pos.y < y1) {
+                            fn(e.item, e.pos);
+                        }
+                    }
+                }
+            }
+        }
+};
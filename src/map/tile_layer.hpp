@@ -0,0 +1,143 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "../sdl/sdl.hpp"
+#include "../geometry.hpp"
+#include "map.hpp"
+
+// Draws the Map tiles. Every Map::block_size square block is baked once
+// into a render target texture, so a frame costs a handful of block copies
+// instead of a copy per tile. A block is rebaked only when its revision in
+// the Map moved, i.e. a tile in it changed. Blocks are baked lazily as they
+// come into view. Renderers without render targets fall back to drawing
+// every tile inside the camera rectangle.
+class TileLayer {
+    public:
+        struct Cell {
+            int col;
+            int row;
+        };
+
+    private:
+        struct Block {
+            std::unique_ptr<sdl::Texture> texture;
+            std::uint32_t revision = 0;
+        };
+
+        std::shared_ptr<sdl::Window> m_window;
+        std::shared_ptr<sdl::Sprite> m_sprite;
+        // Sprite sheet cell for every TileType, indexed by its value
+        std::array<Cell, 4> m_cells;
+        bool m_bake;
+        int m_blocks_w = 0;
+        int m_blocks_h = 0;
+        std::vector<Block> m_blocks;
+        sdl::SpriteBatch m_batch;
+
+        void bake(const Map& map, int bx, int by, Block& block)
+        {
+            int x0 = bx * Map::block_size;
+            int y0 = by * Map::block_size;
+            int x1 = std::min(map.get_w(), x0 + Map::block_size);
+            int y1 = std::min(map.get_h(), y0 + Map::block_size);
+
+            if (!block.texture)
+            {
+                block.texture = std::make_unique<sdl::Texture>(m_window->get_renderer(),
+                        (x1 - x0) * m_sprite->get_w(), (y1 - y0) * m_sprite->get_h());
+            }
+
+            m_window->set_render_target(block.texture.get());
+            m_window->set_draw_color(0, 0, 0, 0xFF);
+            SDL_RenderClear(m_window->get_renderer());
+            draw_cells(x0, y0, x1, y1, Vector2D { -x0, -y0 }, [&map](int x, int y) { return map.get(x, y); });
+            m_window->set_render_target(NULL);
+
+            block.revision = map.block_revision(bx, by);
+        }
+
+    public:
+        TileLayer(std::shared_ptr<sdl::Window> window, std::shared_ptr<sdl::Sprite> sprite)
+        : m_window { window }, m_sprite { sprite }, m_bake { window->supports_render_targets() }
+        {
+            set_cell(TileType::Wall, Cell { 0, 0 });
+            set_cell(TileType::Empty, Cell { 1, 0 });
+            set_cell(TileType::StairsDown, Cell { 2, 0 });
+            set_cell(TileType::StairsUp, Cell { 2, 0 });
+        }
+
+        void set_cell(TileType type, Cell cell) { m_cells[type] = cell; invalidate(); }
+        Cell cell(TileType type) const { return m_cells[type]; }
+
+        // Drops every baked block. Call when switching to another Map and
+        // when the renderer lost its targets (SDL_RENDER_TARGETS_RESET).
+        void invalidate()
+        {
+            m_blocks.clear();
+            m_blocks_w = m_blocks_h = 0;
+        }
+
+        // Only the cells inside the camera's rectangle, which it already
+        // clipped to the map
+        void draw(const Map& map, const Camera& camera)
+        {
+            auto offset = camera.offset;
+            int x0 = camera.x0;
+            int y0 = camera.y0;
+            int x1 = camera.x1;
+            int y1 = camera.y1;
+
+            if (!m_bake)
+            {
+                draw_cells(x0, y0, x1, y1, offset, [&map](int x, int y) { return map.get(x, y); });
+                return;
+            }
+
+            if (x0 >= x1 || y0 >= y1) return;
+
+            int blocks_w = (map.get_w() + Map::block_size - 1) / Map::block_size;
+            int blocks_h = (map.get_h() + Map::block_size - 1) / Map::block_size;
+            if (blocks_w != m_blocks_w || blocks_h != m_blocks_h)
+            {
+                invalidate();
+                m_blocks_w = blocks_w;
+                m_blocks_h = blocks_h;
+                m_blocks.resize(static_cast<std::size_t>(blocks_w) * blocks_h);
+            }
+
+            auto& renderer = m_window->get_renderer();
+            for (int by = y0 / Map::block_size; by <= (y1 - 1) / Map::block_size; ++by) {
+                for (int bx = x0 / Map::block_size; bx <= (x1 - 1) / Map::block_size; ++bx) {
+                    auto& block = m_blocks[static_cast<std::size_t>(by) * m_blocks_w + bx];
+                    if (!block.texture || block.revision != map.block_revision(bx, by))
+                    {
+                        bake(map, bx, by, block);
+                    }
+
+                    block.texture->render(renderer,
+                            (bx * Map::block_size + offset.x) * m_sprite->get_w(),
+                            (by * Map::block_size + offset.y) * m_sprite->get_h());
+                }
+            }
+        }
+
+    private:
+        template <typename TileAt>
+        void draw_cells(int x0, int y0, int x1, int y1, Vector2D offset, TileAt tile_at)
+        {
+            auto w = m_sprite->get_w();
+            auto h = m_sprite->get_h();
+
+            for (int x = x0; x < x1; ++x) {
+                for (int y = y0; y < y1; ++y) {
+                    auto cell = m_cells[tile_at(x, y)];
+                    m_batch.add(*m_sprite, cell.col, cell.row, (x + offset.x)*w, (y + offset.y)*h);
+                }
+            }
+            m_batch.flush(m_window->get_renderer());
+        }
+};
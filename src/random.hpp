@@ -1,18 +1,212 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <time.h>
-#include <stdlib.h>
 
 namespace rng
 {
+    inline std::uint64_t splitmix64(std::uint64_t& state) {
+        std::uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    // xoshiro256** (Blackman, Vigna). Explicitly seeded, 32 bytes of state,
+    // a few cycles per draw. Generators built from the same seed but
+    // different streams are 2^128 draws apart and never overlap.
+    // Usable with <random> and <algorithm> as a UniformRandomBitGenerator.
+    class Rng
+    {
+        private:
+            std::array<std::uint64_t, 4> m_state;
+
+            static std::uint64_t rotl(std::uint64_t x, int k) {
+                return (x << k) | (x >> (64 - k));
+            }
+
+        public:
+            using result_type = std::uint64_t;
+
+            explicit Rng(std::uint64_t seed, std::uint64_t stream = 0) {
+                for (auto& s : m_state) {
+                    s = splitmix64(seed);
+                }
+                for (std::uint64_t i = 0; i < stream; ++i) {
+                    jump();
+                }
+            }
+
+            static constexpr result_type min() { return 0; }
+            static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+            result_type next() {
+                auto result = rotl(m_state[1] * 5, 7) * 9;
+                auto t = m_state[1] << 17;
+
+                m_state[2] ^= m_state[0];
+                m_state[3] ^= m_state[1];
+                m_state[1] ^= m_state[2];
+                m_state[0] ^= m_state[3];
+                m_state[2] ^= t;
+                m_state[3] = rotl(m_state[3], 45);
+
+                return result;
+            }
+
+            result_type operator()() { return next(); }
+
+            // Advances by 2^128 draws
+            void jump() {
+                static constexpr std::uint64_t constants[] = {
+                    0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull, 0xa9582618e03fc9aaull, 0x39abdc4529b1661cull
+                };
+
+                std::array<std::uint64_t, 4> s { 0, 0, 0, 0 };
+                for (auto c : constants) {
+                    for (int b = 0; b < 64; ++b) {
+                        if (c & (std::uint64_t { 1 } << b)) {
+                            for (int i = 0; i < 4; ++i) s[i] ^= m_state[i];
+                        }
+                        next();
+                    }
+                }
+                m_state = s;
+            }
+
+            // Uniform in [0, bound), unbiased (Lemire's multiply and reject)
+            std::uint32_t bounded(std::uint32_t bound) {
+                std::uint64_t m = (next() >> 32) * bound;
+                auto low = static_cast<std::uint32_t>(m);
+                if (low < bound) {
+                    std::uint32_t threshold = -bound % bound;
+                    while (low < threshold) {
+                        m = (next() >> 32) * bound;
+                        low = static_cast<std::uint32_t>(m);
+                    }
+                }
+                return static_cast<std::uint32_t>(m >> 32);
+            }
+
+            // Uniform in [lower, upper)
+            int gen_int(int lower, int upper) {
+                return lower + static_cast<int>(bounded(static_cast<std::uint32_t>(upper - lower)));
+            }
+
+            // Uniform in [0, 1)
+            double gen_double() {
+                return (next() >> 11) * 0x1.0p-53;
+            }
+
+            void fill(std::uint64_t* out, std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i) out[i] = next();
+            }
+
+            // n values uniform in [lower, upper)
+            void fill(int* out, std::size_t n, int lower, int upper) {
+                auto bound = static_cast<std::uint32_t>(upper - lower);
+                for (std::size_t i = 0; i < n; ++i) out[i] = lower + static_cast<int>(bounded(bound));
+            }
+    };
+
+    // Independent sequences derived from the master seed, so e.g. extra AI
+    // decisions do not change the maps that get generated
+    enum class Stream : std::uint64_t {
+        Main,
+        Map,
+        Spawn,
+        AI,
+        Count,
+    };
+
+    namespace detail {
+        constexpr std::size_t stream_count = static_cast<std::size_t>(Stream::Count);
+
+        struct Master {
+            std::atomic<std::uint64_t> seed { 0 };
+            // Bumped by init(), threads reseed when they see it moved
+            std::atomic<std::uint32_t> generation { 0 };
+            // Index for the next thread to draw, 0 is the one calling init()
+            std::atomic<std::uint64_t> threads { 1 };
+        };
+
+        inline Master& master() {
+            static Master master;
+            return master;
+        }
+
+        // Thread i's stream s is the master seed jumped i * Count + s
+        // times, so no two threads or streams ever overlap
+        struct Local {
+            bool indexed = false;
+            std::uint64_t index = 0;
+            std::uint32_t generation = ~0u;
+            std::array<Rng, stream_count> streams { Rng { 0 }, Rng { 0 }, Rng { 0 }, Rng { 0 } };
+        };
+
+        inline Local& local() {
+            thread_local Local local;
+            return local;
+        }
+
+        inline void reseed(Local& local, std::uint32_t generation) {
+            if (!local.indexed) {
+                local.index = master().threads.fetch_add(1);
+                local.indexed = true;
+            }
+            auto seed = master().seed.load(std::memory_order_relaxed);
+            for (std::size_t i = 0; i < local.streams.size(); ++i) {
+                local.streams[i] = Rng { seed, local.index * stream_count + i };
+            }
+            local.generation = generation;
+        }
+    };
+
+    // Reseeds every stream of every thread, the calling one gets index 0;
+    // the same seed replays the same game
+    inline void init(std::uint64_t seed) {
+        auto& master = detail::master();
+        master.seed.store(seed, std::memory_order_relaxed);
+        auto generation = master.generation.fetch_add(1, std::memory_order_release) + 1;
+
+        auto& local = detail::local();
+        local.index = 0;
+        local.indexed = true;
+        detail::reseed(local, generation);
+    }
+
     inline void init() {
         struct timespec ts;
         clock_gettime(CLOCK_MONOTONIC, &ts);
 
-        srand((time_t)ts.tv_nsec);
+        init(static_cast<std::uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec);
+    }
+
+    inline std::uint64_t seed() { return detail::master().seed.load(std::memory_order_relaxed); }
+
+    // The calling thread's own stream, no locking. Other threads draw from
+    // theirs in the order they first asked, so only the thread which
+    // called init() replays exactly; work which must replay elsewhere
+    // takes a seed from here, as generate_level does.
+    inline Rng& stream(Stream s) {
+        auto& local = detail::local();
+        auto generation = detail::master().generation.load(std::memory_order_acquire);
+        if (local.generation != generation) {
+            detail::reseed(local, generation);
+        }
+        return local.streams[static_cast<std::size_t>(s)];
     }
 
     inline int gen_int(int lower, int upper) {
-        return rand() % (upper - lower) + lower;
+        return stream(Stream::Main).gen_int(lower, upper);
+    }
+
+    // Seed for a new Rng
+    inline std::uint64_t gen_seed(Stream s = Stream::Main) {
+        return stream(s).next();
     }
 };
@@ -3,11 +3,16 @@
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_ttf.h>
+#include <algorithm>
 #include <cassert>
 #include <optional>
 #include <memory>
 #include <unordered_map>
 #include <string>
+#include <tuple>
+#include <vector>
+
+#include "../logging.hpp"
 
 namespace sdl
 {
@@ -179,6 +184,14 @@ namespace sdl
             int m_height = 0;
             int m_width = 0;
             SDL_Texture* m_texture;
+            // In creation order, unlike the SDL_Texture address
+            std::uint32_t m_id = next_id();
+
+            static std::uint32_t next_id()
+            {
+                static std::uint32_t id = 0;
+                return id++;
+            }
 
             void set_dimensions(Surface& surface)
             {
@@ -209,11 +222,42 @@ namespace sdl
                 m_texture = SDL_CreateTextureFromSurface(renderer, surface);
             }
 
+            // Blank RGBA8888 texture. With SDL_TEXTUREACCESS_TARGET it can be
+            // drawn into (see Window::set_render_target), with
+            // SDL_TEXTUREACCESS_STREAMING written through lock()
+            explicit Texture(Renderer& renderer, int w, int h, int access = SDL_TEXTUREACCESS_TARGET)
+            : m_height { h }, m_width { w },
+              m_texture { SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, access, w, h) }
+            {
+                if (m_texture == NULL)
+                {
+                    throw std::runtime_error(strcat(strdup("Could not create blank texture: "), SDL_GetError()));
+                }
+            }
+
+            // Write only access to `rect` of a streaming texture, every
+            // pixel in it has to be written before unlock()
+            Uint32* lock(const SDL_Rect& rect, int& pitch)
+            {
+                void* pixels = NULL;
+                if (SDL_LockTexture(m_texture, &rect, &pixels, &pitch) != 0)
+                {
+                    throw std::runtime_error(strcat(strdup("Could not lock texture: "), SDL_GetError()));
+                }
+                return static_cast<Uint32*>(pixels);
+            }
+
+            void unlock()
+            {
+                SDL_UnlockTexture(m_texture);
+            }
+
             SDL_Texture& operator*()  { return *(m_texture); }
             operator SDL_Texture*()   { return m_texture; }
 
             int get_w() { return m_width; };
             int get_h() { return m_height; };
+            std::uint32_t get_id() const { return m_id; }
 
             void render(SDL_Renderer* renderer, int x, int y, double angle = 0.0, SDL_Point* center = NULL, SDL_RendererFlip flip = SDL_FLIP_NONE)
             {
@@ -246,20 +290,28 @@ namespace sdl
             }
     };
 
+    // Cells of a sprite sheet. The sheet is either a texture of its own or
+    // a region of a shared atlas (see SpriteManager); cells are addressed by
+    // col/row either way. Colour, alpha and blend mode belong to the sprite
+    // and are applied per draw, so sprites sharing an atlas don't leak them
+    // to each other.
     class Sprite
     {
         private:
-            Texture m_texture;
+            std::shared_ptr<Texture> m_texture;
+            SDL_Point m_origin { 0, 0 };
             int m_rows = 0;
             int m_cols = 0;
             int m_width = 0;
             int m_height = 0;
+            SDL_Color m_color { 255, 255, 255, 255 };
+            SDL_BlendMode m_blend = SDL_BLENDMODE_BLEND;
 
             SDL_Rect clip_rect(int col, int row)
             {
                 SDL_Rect rect;
-                rect.x = m_width * col;
-                rect.y = m_height * row;
+                rect.x = m_origin.x + m_width * col;
+                rect.y = m_origin.y + m_height * row;
                 rect.w = m_width;
                 rect.h = m_height;
 
@@ -280,7 +332,14 @@ namespace sdl
             Sprite() {}
 
             Sprite(std::string path, Renderer& renderer, int rows, int cols, int width, int height, std::optional<RGB> ock)
-            : m_texture { path, renderer, ock },
+            : m_texture { std::make_shared<Texture>(path, renderer, ock) },
+              m_rows { rows }, m_cols { cols },
+              m_width { width }, m_height { height }
+            { }
+
+            // Sheet stored at `origin` inside `atlas`
+            Sprite(std::shared_ptr<Texture> atlas, SDL_Point origin, int rows, int cols, int width, int height)
+            : m_texture { atlas }, m_origin { origin },
               m_rows { rows }, m_cols { cols },
               m_width { width }, m_height { height }
             { }
@@ -293,24 +352,46 @@ namespace sdl
                 auto clip = clip_rect(col, row);
                 auto renderQuad = render_rect(x, y);
 
-                SDL_RenderCopyEx(renderer, m_texture, &clip, &renderQuad, angle, center, flip);
+                SDL_SetTextureColorMod(*m_texture, m_color.r, m_color.g, m_color.b);
+                SDL_SetTextureAlphaMod(*m_texture, m_color.a);
+                SDL_SetTextureBlendMode(*m_texture, m_blend);
+                SDL_RenderCopyEx(renderer, *m_texture, &clip, &renderQuad, angle, center, flip);
+            }
+
+            // Area of the texture holding cell (col, row)
+            SDL_Rect get_clip(int col, int row)
+            {
+                assert(col < m_cols);
+                assert(row < m_rows);
+                return clip_rect(col, row);
             }
 
+            Texture& get_texture()
+            { return *m_texture; }
+
             void set_color_mod(RGB rgb)
             {
-                m_texture.set_color_mod(rgb);
+                m_color.r = rgb.r;
+                m_color.g = rgb.g;
+                m_color.b = rgb.b;
             }
 
             void set_blend_mode(SDL_BlendMode blending)
             {
-                m_texture.set_blend_mode(blending);
+                m_blend = blending;
             }
 
             void set_alpha(Uint8 alpha)
             {
-                m_texture.set_alpha(alpha);
+                m_color.a = alpha;
             }
 
+            SDL_Color get_color() const
+            { return m_color; }
+
+            SDL_BlendMode get_blend_mode() const
+            { return m_blend; }
+
             int get_w() const
             { return m_width; }
 
@@ -318,6 +399,185 @@ namespace sdl
             { return m_height; }
     };
 
+    // Collects the quads of a frame and submits them grouped by layer,
+    // texture and blend mode: one SDL_RenderGeometry call per group instead
+    // of a copy per sprite. Lower layers are drawn first, then textures in
+    // the order they were created; within a group quads keep the order they
+    // were added in, so the result is the same from run to run. Flips are done by swapping
+    // texture coordinates, colour and alpha go into the vertices, so
+    // neither needs the Ex path. Rotated quads and groups of one take a
+    // plain copy instead.
+    class SpriteBatch
+    {
+        private:
+            struct Quad
+            {
+                SDL_Texture* texture;
+                std::uint32_t texture_id;
+                SDL_BlendMode blend;
+                int layer;
+                std::uint32_t order;
+                SDL_Rect src;
+                SDL_Rect dst;
+                SDL_Color color;
+                SDL_RendererFlip flip;
+                double angle;
+                float u0, v0, u1, v1;
+            };
+
+            std::vector<Quad> m_quads;
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+            std::vector<SDL_Vertex> m_vertices;
+            std::vector<int> m_indices;
+#endif
+            int m_draw_calls = 0;
+
+            static bool same_group(const Quad& a, const Quad& b)
+            {
+                return a.layer == b.layer && a.texture == b.texture && a.blend == b.blend;
+            }
+
+            void copy(SDL_Renderer* renderer, const Quad& q)
+            {
+                SDL_SetTextureColorMod(q.texture, q.color.r, q.color.g, q.color.b);
+                SDL_SetTextureAlphaMod(q.texture, q.color.a);
+                if (q.flip == SDL_FLIP_NONE && q.angle == 0.0)
+                {
+                    SDL_RenderCopy(renderer, q.texture, &q.src, &q.dst);
+                }
+                else
+                {
+                    SDL_RenderCopyEx(renderer, q.texture, &q.src, &q.dst, q.angle, NULL, q.flip);
+                }
+                ++m_draw_calls;
+            }
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+            void submit_geometry(SDL_Renderer* renderer, SDL_Texture* texture)
+            {
+                if (m_indices.empty()) return;
+
+                SDL_SetTextureColorMod(texture, 255, 255, 255);
+                SDL_SetTextureAlphaMod(texture, 255);
+                SDL_RenderGeometry(renderer, texture, m_vertices.data(), static_cast<int>(m_vertices.size()),
+                        m_indices.data(), static_cast<int>(m_indices.size()));
+                ++m_draw_calls;
+
+                m_vertices.clear();
+                m_indices.clear();
+            }
+
+            void append(const Quad& q)
+            {
+                auto base = static_cast<int>(m_vertices.size());
+                float x0 = static_cast<float>(q.dst.x);
+                float y0 = static_cast<float>(q.dst.y);
+                float x1 = static_cast<float>(q.dst.x + q.dst.w);
+                float y1 = static_cast<float>(q.dst.y + q.dst.h);
+
+                float u0 = q.u0, u1 = q.u1, v0 = q.v0, v1 = q.v1;
+                if (q.flip & SDL_FLIP_HORIZONTAL) std::swap(u0, u1);
+                if (q.flip & SDL_FLIP_VERTICAL) std::swap(v0, v1);
+
+                m_vertices.push_back(SDL_Vertex { SDL_FPoint { x0, y0 }, q.color, SDL_FPoint { u0, v0 } });
+                m_vertices.push_back(SDL_Vertex { SDL_FPoint { x1, y0 }, q.color, SDL_FPoint { u1, v0 } });
+                m_vertices.push_back(SDL_Vertex { SDL_FPoint { x1, y1 }, q.color, SDL_FPoint { u1, v1 } });
+                m_vertices.push_back(SDL_Vertex { SDL_FPoint { x0, y1 }, q.color, SDL_FPoint { u0, v1 } });
+
+                for (int i : { 0, 1, 2, 0, 2, 3 })
+                {
+                    m_indices.push_back(base + i);
+                }
+            }
+#endif
+
+            void submit(SDL_Renderer* renderer, std::size_t from, std::size_t to)
+            {
+                auto texture = m_quads[from].texture;
+                SDL_SetTextureBlendMode(texture, m_quads[from].blend);
+
+                if (to - from == 1)
+                {
+                    copy(renderer, m_quads[from]);
+                    return;
+                }
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+                for (auto i = from; i < to; ++i)
+                {
+                    if (m_quads[i].angle != 0.0)
+                    {
+                        submit_geometry(renderer, texture);
+                        copy(renderer, m_quads[i]);
+                    }
+                    else
+                    {
+                        append(m_quads[i]);
+                    }
+                }
+                submit_geometry(renderer, texture);
+#else
+                for (auto i = from; i < to; ++i)
+                {
+                    copy(renderer, m_quads[i]);
+                }
+#endif
+            }
+
+        public:
+            // Queues cell (col, row) of `sprite` at pixel (x, y)
+            void add(Sprite& sprite, int col, int row, int x, int y, int layer = 0,
+                    SDL_Color color = SDL_Color { 255, 255, 255, 255 },
+                    SDL_RendererFlip flip = SDL_FLIP_NONE, double angle = 0.0)
+            {
+                auto& texture = sprite.get_texture();
+                auto mod = sprite.get_color();
+                color.r = static_cast<Uint8>(color.r * mod.r / 255);
+                color.g = static_cast<Uint8>(color.g * mod.g / 255);
+                color.b = static_cast<Uint8>(color.b * mod.b / 255);
+                color.a = static_cast<Uint8>(color.a * mod.a / 255);
+
+                auto src = sprite.get_clip(col, row);
+                float tw = static_cast<float>(texture.get_w());
+                float th = static_cast<float>(texture.get_h());
+
+                m_quads.push_back(Quad {
+                        texture, texture.get_id(), sprite.get_blend_mode(), layer, static_cast<std::uint32_t>(m_quads.size()),
+                        src, SDL_Rect { x, y, sprite.get_w(), sprite.get_h() }, color, flip, angle,
+                        src.x / tw, src.y / th, (src.x + src.w) / tw, (src.y + src.h) / th });
+            }
+
+            // Draws and forgets everything queued. Buffers are kept, so a
+            // steady frame allocates nothing.
+            void flush(SDL_Renderer* renderer)
+            {
+                m_draw_calls = 0;
+                if (m_quads.empty()) return;
+
+                std::sort(m_quads.begin(), m_quads.end(), [](const Quad& a, const Quad& b)
+                        {
+                            return std::tie(a.layer, a.texture_id, a.blend, a.order) < std::tie(b.layer, b.texture_id, b.blend, b.order);
+                        });
+
+                std::size_t from = 0;
+                for (std::size_t i = 1; i <= m_quads.size(); ++i)
+                {
+                    if (i == m_quads.size() || !same_group(m_quads[from], m_quads[i]))
+                    {
+                        submit(renderer, from, i);
+                        from = i;
+                    }
+                }
+
+                m_quads.clear();
+            }
+
+            std::size_t size() const { return m_quads.size(); }
+
+            // Render calls made by the last flush
+            int draw_calls() const { return m_draw_calls; }
+    };
+
     class Window
     {
         private:
@@ -406,6 +666,17 @@ namespace sdl
                 return std::pair<int, int> { DM.w, DM.h };
             }
 
+            bool supports_render_targets()
+            {
+                return SDL_RenderTargetSupported(m_renderer) == SDL_TRUE;
+            }
+
+            // Draws go to `target` until this is called again with NULL
+            void set_render_target(Texture* target)
+            {
+                SDL_SetRenderTarget(m_renderer, target == NULL ? NULL : static_cast<SDL_Texture*>(*target));
+            }
+
             void set_draw_color(int r, int g, int b, int a)
             {
                 SDL_SetRenderDrawColor(m_renderer, r, g, b, a);
@@ -424,33 +695,255 @@ namespace sdl
             }
     };
 
+    // Skyline bottom-left rectangle packer. The skyline is the top edge of
+    // everything placed so far, kept as horizontal segments; a rectangle
+    // goes where it rests lowest, ties broken by the narrower fit.
+    class SkylinePacker
+    {
+        private:
+            struct Segment
+            {
+                int x;
+                int y;
+                int w;
+            };
+
+            int m_width;
+            int m_height;
+            std::vector<Segment> m_skyline;
+
+            // Height a w wide rectangle rests at when its left edge is at
+            // segment i, -1 if it doesn't fit there
+            int rest_height(std::size_t i, int w, int h) const
+            {
+                if (m_skyline[i].x + w > m_width) return -1;
+
+                int y = 0;
+                int left = w;
+                for (auto j = i; left > 0; ++j)
+                {
+                    y = std::max(y, m_skyline[j].y);
+                    if (y + h > m_height) return -1;
+                    left -= m_skyline[j].w;
+                }
+                return y;
+            }
+
+        public:
+            SkylinePacker(int width, int height)
+            : m_width { width }, m_height { height }, m_skyline { Segment { 0, 0, width } }
+            { }
+
+            int get_w() const { return m_width; }
+            int get_h() const { return m_height; }
+
+            // Top left corner of the place reserved for a w x h rectangle
+            std::optional<SDL_Point> insert(int w, int h)
+            {
+                int best_y = m_height;
+                int best_w = m_width + 1;
+                std::size_t best = m_skyline.size();
+
+                for (std::size_t i = 0; i < m_skyline.size(); ++i)
+                {
+                    int y = rest_height(i, w, h);
+                    if (y >= 0 && (y < best_y || (y == best_y && m_skyline[i].w < best_w)))
+                    {
+                        best = i;
+                        best_y = y;
+                        best_w = m_skyline[i].w;
+                    }
+                }
+
+                if (best == m_skyline.size()) return std::nullopt;
+
+                int x = m_skyline[best].x;
+                m_skyline.insert(m_skyline.begin() + best, Segment { x, best_y + h, w });
+
+                // Trim what the new segment covers
+                auto i = best + 1;
+                while (i < m_skyline.size() && m_skyline[i].x < x + w)
+                {
+                    int overlap = x + w - m_skyline[i].x;
+                    if (overlap >= m_skyline[i].w)
+                    {
+                        m_skyline.erase(m_skyline.begin() + i);
+                    }
+                    else
+                    {
+                        m_skyline[i].x += overlap;
+                        m_skyline[i].w -= overlap;
+                        break;
+                    }
+                }
+
+                // Merge neighbours of equal height
+                for (std::size_t j = 0; j + 1 < m_skyline.size();)
+                {
+                    if (m_skyline[j].y == m_skyline[j + 1].y)
+                    {
+                        m_skyline[j].w += m_skyline[j + 1].w;
+                        m_skyline.erase(m_skyline.begin() + j + 1);
+                    }
+                    else
+                    {
+                        ++j;
+                    }
+                }
+
+                return SDL_Point { x, best_y };
+            }
+    };
+
+    // Loads sprite sheets and packs them into shared atlas textures, so
+    // sprites of different sheets can be drawn in one batch. Sheets are
+    // packed when the first sprite is asked for after preloading; sheets
+    // preloaded later start a new atlas. A sheet too big for an atlas gets
+    // a texture of its own. Sheets drawn facing the wrong way are mirrored
+    // once here, cell by cell, so drawing never needs a flip.
     class SpriteManager
     {
         private:
+            struct Sheet
+            {
+                std::string path;
+                std::unique_ptr<Surface> surface;
+                int rows;
+                int cols;
+                int width;
+                int height;
+                bool mirrored;
+            };
+
+            // Empty pixels around every sheet so filtering never samples a
+            // neighbour
+            static constexpr int padding = 1;
+
             std::shared_ptr<Window> m_window;
             std::unordered_map<std::string, std::shared_ptr<Sprite>> m_sprites;
+            std::vector<Sheet> m_pending;
+            std::vector<std::shared_ptr<Texture>> m_atlases;
+            int m_atlas_size;
+
+            void load(std::string path, int rows, int cols, int width, int height, std::optional<RGB> ck, bool mirrored)
+            {
+                m_pending.push_back(Sheet { path, std::make_unique<Surface>(path, ck), rows, cols, width, height, mirrored });
+            }
+
+            // Mirrors every `cell_w` wide cell of `rect` in place, 32 bit
+            // surfaces only
+            static void mirror_cells(SDL_Surface* surface, SDL_Rect rect, int cell_w)
+            {
+                SDL_LockSurface(surface);
+                for (int y = rect.y; y < rect.y + rect.h; ++y)
+                {
+                    auto row = reinterpret_cast<Uint32*>(static_cast<Uint8*>(surface->pixels) + y * surface->pitch);
+                    for (int x = rect.x; x + cell_w <= rect.x + rect.w; x += cell_w)
+                    {
+                        std::reverse(row + x, row + x + cell_w);
+                    }
+                }
+                SDL_UnlockSurface(surface);
+            }
+
+            // Blits the pending sheets onto as few atlas surfaces as
+            // needed, tallest first, then turns each into a texture
+            void pack()
+            {
+                std::sort(m_pending.begin(), m_pending.end(), [](const Sheet& a, const Sheet& b)
+                        {
+                            return a.surface->get_h() > b.surface->get_h();
+                        });
+
+                while (!m_pending.empty())
+                {
+                    SkylinePacker packer { m_atlas_size, m_atlas_size };
+                    SDL_Surface* atlas = SDL_CreateRGBSurfaceWithFormat(0, m_atlas_size, m_atlas_size, 32, SDL_PIXELFORMAT_RGBA32);
+                    if (atlas == NULL)
+                    {
+                        throw std::runtime_error(strcat(strdup("Could not create atlas surface: "), SDL_GetError()));
+                    }
+                    SDL_FillRect(atlas, NULL, SDL_MapRGBA(atlas->format, 0, 0, 0, 0));
+
+                    std::vector<Sheet> rest;
+                    std::vector<std::pair<Sheet, SDL_Point>> packed;
+                    for (auto& sheet : m_pending)
+                    {
+                        auto w = sheet.surface->get_w();
+                        auto h = sheet.surface->get_h();
+                        auto spot = packer.insert(w + 2 * padding, h + 2 * padding);
+
+                        if (!spot)
+                        {
+                            if (w + 2 * padding > m_atlas_size || h + 2 * padding > m_atlas_size)
+                            {
+                                logger::info("Sprite sheet does not fit an atlas, keeping its own texture", sheet.path);
+                                if (sheet.mirrored)
+                                {
+                                    sheet.surface = std::make_unique<Surface>(SDL_ConvertSurfaceFormat(*sheet.surface, SDL_PIXELFORMAT_RGBA32, 0));
+                                    mirror_cells(*sheet.surface, SDL_Rect { 0, 0, w, h }, sheet.width);
+                                }
+                                auto texture = std::make_shared<Texture>(std::move(*sheet.surface), m_window->get_renderer());
+                                m_sprites[sheet.path] = std::make_shared<Sprite>(texture, SDL_Point { 0, 0 }, sheet.rows, sheet.cols, sheet.width, sheet.height);
+                            }
+                            else
+                            {
+                                rest.push_back(std::move(sheet));
+                            }
+                            continue;
+                        }
+
+                        SDL_Point origin { spot->x + padding, spot->y + padding };
+                        SDL_Rect dst { origin.x, origin.y, w, h };
+                        // Copy pixels as they are, colour keyed ones stay
+                        // transparent
+                        SDL_SetSurfaceBlendMode(*sheet.surface, SDL_BLENDMODE_NONE);
+                        SDL_BlitSurface(*sheet.surface, NULL, atlas, &dst);
+                        if (sheet.mirrored)
+                        {
+                            mirror_cells(atlas, dst, sheet.width);
+                        }
+                        packed.emplace_back(std::move(sheet), origin);
+                    }
+
+                    auto texture = std::make_shared<Texture>(Surface { atlas }, m_window->get_renderer());
+                    for (auto& [sheet, origin] : packed)
+                    {
+                        m_sprites[sheet.path] = std::make_shared<Sprite>(texture, origin, sheet.rows, sheet.cols, sheet.width, sheet.height);
+                    }
+                    logger::info("Packed sprite sheets into atlas", m_atlases.size(), "sheets", packed.size());
+                    m_atlases.push_back(texture);
+
+                    m_pending = std::move(rest);
+                }
+            }
+
         public:
-            SpriteManager(std::shared_ptr<Window> window) : m_window { window }, m_sprites { } { };
+            SpriteManager(std::shared_ptr<Window> window, int atlas_size = 1024)
+            : m_window { window }, m_sprites { }, m_atlas_size { atlas_size } { };
             ~SpriteManager() { };
 
-            void preload_sprite(std::string path, int rows, int cols, int width, int height)
+            void preload_sprite(std::string path, int rows, int cols, int width, int height, bool mirrored = false)
             {
-                auto sprite = std::make_shared<Sprite>(path, m_window->get_renderer(), rows, cols, width, height, std::nullopt);
-                m_sprites[path] = sprite;
+                load(path, rows, cols, width, height, std::nullopt, mirrored);
             }
 
-            void preload_sprite(std::string path, int rows, int cols, int width, int height, RGB ck)
+            void preload_sprite(std::string path, int rows, int cols, int width, int height, RGB ck, bool mirrored = false)
             {
-                auto sprite = std::make_shared<Sprite>(path, m_window->get_renderer(), rows, cols, width, height, std::optional<RGB>{ ck });
-                m_sprites[path] = sprite;
+                load(path, rows, cols, width, height, std::optional<RGB>{ ck }, mirrored);
             }
 
             std::shared_ptr<Sprite> get_sprite(std::string path)
             {
+                if (!m_pending.empty())
+                    pack();
+
                 if (m_sprites.find(path) == m_sprites.end())
                     throw std::runtime_error("Could not find sprite for " + path);
 
                 return m_sprites[path];
             }
+
+            std::size_t atlas_count() const { return m_atlases.size(); }
     };
 }
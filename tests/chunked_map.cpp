@@ -0,0 +1,139 @@
+// ChunkedMap: same seed same world, connected across chunk borders,
+// bounded residency while walking, changes surviving a page out and
+// discarded ones not
+#include <cstdio>
+#include <filesystem>
+#include <unistd.h>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "map/chunked_map.hpp"
+#include "test.hpp"
+
+int main() {
+    logger::init("tests.log");
+    BspGenerator generator;
+
+    auto pages = std::filesystem::temp_directory_path() / ("chunked_map_test_" + std::to_string(::getpid()));
+    std::filesystem::create_directories(pages);
+
+    {
+        ChunkedMap map { 42, generator, 2, pages.string() };
+        map.focus(Vector2D { 0, 0 });
+        map.wait();
+        CHECK(map.resident_count() == 25);
+        CHECK(map.pending_count() == 0);
+
+        // Everything open in the resident 5x5 chunks is reachable from the
+        // centre chunk's hub
+        Rect region;
+        region.x0 = -2 * Chunk::size;
+        region.y0 = -2 * Chunk::size;
+        region.x1 = 3 * Chunk::size;
+        region.y1 = 3 * Chunk::size;
+        int w = region.x1 - region.x0;
+        int h = region.y1 - region.y0;
+        Grid<TileType> tiles { w, h, TileType::Wall };
+        map.copy_region(region, tiles);
+
+        BitGrid reached { w, h };
+        std::queue<Vector2D> queue;
+        Vector2D hub { Chunk::size / 2 - region.x0, Chunk::size / 2 - region.y0 };
+        CHECK(tiles.get(hub.x, hub.y) != TileType::Wall);
+        reached.set(hub.x, hub.y);
+        queue.push(hub);
+        while (!queue.empty()) {
+            auto p = queue.front();
+            queue.pop();
+            for (auto d : { Vector2D { 1, 0 }, Vector2D { -1, 0 }, Vector2D { 0, 1 }, Vector2D { 0, -1 } }) {
+                auto n = p + d;
+                if (tiles.in_bounds(n.x, n.y) && tiles.get(n.x, n.y) != TileType::Wall && !reached.test(n.x, n.y)) {
+                    reached.set(n.x, n.y);
+                    queue.push(n);
+                }
+            }
+        }
+        std::size_t open = 0;
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                open += tiles.get(x, y) != TileType::Wall;
+            }
+        }
+        CHECK(reached.count() == open);
+
+        // Changes made before walking away come back from the page file
+        auto tile = map.at(5, 5);
+        map.memoize(5, 5);
+        map.set_tile(6, 5, TileType::StairsUp);
+        std::size_t most = 0;
+        for (int i = 1; i <= 40; ++i) {
+            map.focus(Vector2D { i * Chunk::size, i * 7 });
+            most = std::max(most, map.resident_count() + map.pending_count());
+        }
+        map.wait();
+        // The resident square plus one chunk of slack on every side
+        CHECK(most <= 49);
+        CHECK(!map.resident(5, 5));
+
+        map.focus(Vector2D { 0, 0 });
+        map.wait();
+        CHECK(map.memoized(5, 5));
+        CHECK(!map.memoized(4, 5));
+        CHECK(map.at(5, 5) == tile);
+        CHECK(map.at(6, 5) == TileType::StairsUp);
+
+        // Another map from the same seed generates the same cells
+        ChunkedMap same { 42, generator, 1 };
+        same.focus(Vector2D { -40, 70 });
+        same.wait();
+        int differ = 0;
+        for (int y = 50; y < 90; ++y) {
+            for (int x = -60; x < -20; ++x) {
+                differ += same.at(x, y) != map.at(x, y);
+            }
+        }
+        CHECK(differ == 0);
+    }
+
+    // Destroying the map pages out what was still resident
+    {
+        ChunkedMap map { 42, generator, 2, pages.string() };
+        map.focus(Vector2D { 0, 0 });
+        map.wait();
+        CHECK(map.memoized(5, 5));
+        CHECK(map.at(6, 5) == TileType::StairsUp);
+    }
+
+    // A discarded map writes nothing back, region residency never blocks
+    {
+        ChunkedMap map { 42, generator, 2, pages.string() };
+        Rect near;
+        near.x0 = -Chunk::size;
+        near.y0 = -Chunk::size;
+        near.x1 = 2 * Chunk::size;
+        near.y1 = 2 * Chunk::size;
+        CHECK(!map.resident(near));
+        map.focus(Vector2D { 0, 0 });
+        map.wait();
+        CHECK(map.resident(near));
+        Rect far = near;
+        far.x1 = 4 * Chunk::size;
+        CHECK(!map.resident(far));
+
+        map.memoize(9, 9);
+        map.set_tile(6, 5, TileType::Empty);
+        map.discard();
+        CHECK(map.resident_count() == 0);
+    }
+    {
+        ChunkedMap map { 42, generator, 2, pages.string() };
+        map.focus(Vector2D { 0, 0 });
+        map.wait();
+        CHECK(!map.memoized(9, 9));
+        CHECK(map.at(6, 5) == TileType::StairsUp);
+    }
+
+    std::filesystem::remove_all(pages);
+    return test::result("chunked_map");
+}
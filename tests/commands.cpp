@@ -0,0 +1,65 @@
+// CommandBuffer: recording order, pending entities, and nothing applied
+// twice after a command threw
+#include <stdexcept>
+
+#include "ecs/ecs.hpp"
+#include "test.hpp"
+
+struct Position { int x; };
+struct Velocity {
+    using Requires = ecs::TypeList<Position>;
+    int dx;
+};
+
+template <typename T>
+struct ecs::ComponentId : ecs::type_index<T, ecs::TypeList<Position, Velocity>> { };
+
+int main() {
+    logger::init("tests.log");
+    ecs::World world;
+    ecs::CommandBuffer commands;
+
+    // Pending entities resolve within the flush which creates them
+    auto a = commands.create();
+    commands.add_component<Position>(a, Position { 1 });
+    commands.add_component<Velocity>(a, Velocity { 2 });
+    auto b = commands.create();
+    commands.destroy(b);
+    commands.flush(world);
+    CHECK(commands.empty());
+    CHECK(world.size() == 1);
+    int moving = 0;
+    world.view<Position, Velocity>().each([&](Position& p, Velocity& v) { moving += p.x == 1 && v.dx == 2; });
+    CHECK(moving == 1);
+
+    // Velocity without a Position throws half way through
+    auto spawned = commands.create();
+    commands.add_component<Position>(spawned, Position { 3 });
+    auto broken = commands.create();
+    commands.add_component<Velocity>(broken, Velocity { 4 });
+    commands.add_component<Position>(broken, Position { 5 });
+    bool threw = false;
+    try {
+        commands.flush(world);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(commands.empty());
+    auto after_throw = world.size();
+    CHECK(after_throw == 3);
+
+    // Flushing again runs nothing a second time
+    commands.flush(world);
+    CHECK(world.size() == after_throw);
+    int positions = 0;
+    world.view<Position>().each([&](Position&) { ++positions; });
+    CHECK(positions == 2);
+
+    // The buffer still works afterwards
+    commands.add_component<Position>(commands.create(), Position { 6 });
+    commands.flush(world);
+    CHECK(world.size() == after_throw + 1);
+
+    return test::result("commands");
+}
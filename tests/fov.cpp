@@ -0,0 +1,166 @@
+// Shadowcasting against a brute force Bresenham line of sight.
+//
+// Both walk the line from the origin along its major axis and look at the
+// cell(s) nearest to it on every row in between. Shadowcasting blocks a
+// row's light exactly across the wall cells there, so:
+// - a cell is seen when on every row in between all cells nearest to the
+//   line are open ("strict" line of sight),
+// - a floor cell is only seen when on every row in between at least one of
+//   them is ("permissive"; they differ where the line passes exactly
+//   between two cells).
+#include <cstdlib>
+#include <vector>
+
+#include "map/fov.hpp"
+#include "map/generators.hpp"
+#include "random.hpp"
+#include "test.hpp"
+
+enum class Ties { Strict, Permissive };
+
+bool opaque(const Grid<TileType> &map, int x, int y) {
+    return !map.in_bounds(x, y) || map.get(x, y) == TileType::Wall;
+}
+
+int floor_div(int a, int b) {
+    int q = a / b;
+    return (a % b != 0 && ((a < 0) != (b < 0))) ? q - 1 : q;
+}
+
+bool line_of_sight(const Grid<TileType> &map, Vector2D from, Vector2D to, Ties ties) {
+    auto d = to - from;
+    bool x_major = std::abs(d.x) >= std::abs(d.y);
+    int steps = x_major ? std::abs(d.x) : std::abs(d.y);
+    int minor = x_major ? d.y : d.x;
+    int step = (x_major ? d.x : d.y) < 0 ? -1 : 1;
+
+    auto cell_opaque = [&](int i, int offset) {
+        return x_major ? opaque(map, from.x + step * i, from.y + offset) : opaque(map, from.x + offset, from.y + step * i);
+    };
+
+    for (int i = 1; i < steps; ++i) {
+        // The line crosses row i at minor offset i * minor / steps, twice
+        // that is an odd integer when it passes between two cells
+        int twice = 2 * i * minor;
+        if (twice % steps == 0 && (twice / steps) % 2 != 0) {
+            bool a = cell_opaque(i, (twice / steps - 1) / 2);
+            bool b = cell_opaque(i, (twice / steps + 1) / 2);
+            if (ties == Ties::Strict ? (a || b) : (a && b)) {
+                return false;
+            }
+        } else if (cell_opaque(i, floor_div(twice + steps, 2 * steps))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<Vector2D> floors(const Grid<TileType> &map) {
+    std::vector<Vector2D> cells;
+    for (int y = 0; y < map.get_h(); ++y) {
+        for (int x = 0; x < map.get_w(); ++x) {
+            if (map.get(x, y) != TileType::Wall) {
+                cells.push_back(Vector2D { x, y });
+            }
+        }
+    }
+    return cells;
+}
+
+// Every cell within `radius` of origin against both references
+void compare(const Fov &fov, const Grid<TileType> &map, Vector2D origin, int radius) {
+    BitGrid visible { map.get_w(), map.get_h() };
+    fov.compute(map, origin, radius, visible);
+
+    int missed = 0;
+    int leaked = 0;
+    for (int y = origin.y - radius; y <= origin.y + radius; ++y) {
+        for (int x = origin.x - radius; x <= origin.x + radius; ++x) {
+            auto d = Vector2D { x, y } - origin;
+            if (!map.in_bounds(x, y) || d.x * d.x + d.y * d.y > radius * radius) {
+                continue;
+            }
+
+            Vector2D cell { x, y };
+            bool seen = visible.test(x, y);
+            if (!seen && line_of_sight(map, origin, cell, Ties::Strict)) {
+                ++missed;
+            }
+            if (seen && map.get(x, y) != TileType::Wall && !line_of_sight(map, origin, cell, Ties::Permissive)) {
+                ++leaked;
+            }
+        }
+    }
+    CHECK(missed == 0);
+    CHECK(leaked == 0);
+}
+
+int main() {
+    logger::init("tests.log");
+    ShadowcastingFov shadowcasting;
+
+    // No walls: exactly the disc, which is also what Bresenham sees
+    {
+        Grid<TileType> open { 81, 81, TileType::Empty };
+        BitGrid visible { 81, 81 };
+        Vector2D origin { 40, 40 };
+        shadowcasting.compute(open, origin, 30, visible);
+        int wrong = 0;
+        for (int y = 0; y < 81; ++y) {
+            for (int x = 0; x < 81; ++x) {
+                auto d = Vector2D { x, y } - origin;
+                bool in_disc = d.x * d.x + d.y * d.y <= 30 * 30;
+                wrong += visible.test(x, y) != in_disc;
+                wrong += in_disc && !line_of_sight(open, origin, Vector2D { x, y }, Ties::Strict);
+            }
+        }
+        CHECK(wrong == 0);
+    }
+
+    rng::Rng rng { 7 };
+
+    // Random pillars at several densities, every radius up to 20
+    for (int density : { 5, 15, 30, 45 }) {
+        Grid<TileType> map { 64, 64, TileType::Empty };
+        for (int y = 0; y < 64; ++y) {
+            for (int x = 0; x < 64; ++x) {
+                if (rng.gen_int(0, 100) < density) {
+                    map.set(x, y, TileType::Wall);
+                }
+            }
+        }
+        auto cells = floors(map);
+        for (int i = 0; i < 40; ++i) {
+            compare(shadowcasting, map, cells[rng.gen_int(0, static_cast<int>(cells.size()))], 1 + i % 20);
+        }
+    }
+
+    // Generated levels, near the edges too
+    CaveGenerator cave;
+    RoomsGenerator rooms;
+    for (const Generator *generator : { static_cast<const Generator*>(&cave), static_cast<const Generator*>(&rooms) }) {
+        Grid<TileType> map { 100, 100, TileType::Wall };
+        generator->generate(map, rng);
+        auto cells = floors(map);
+        for (int i = 0; i < 100; ++i) {
+            compare(shadowcasting, map, cells[rng.gen_int(0, static_cast<int>(cells.size()))], 15);
+        }
+
+        // Symmetry between floor cells
+        int asymmetric = 0;
+        for (int i = 0; i < 50; ++i) {
+            auto a = cells[rng.gen_int(0, static_cast<int>(cells.size()))];
+            BitGrid from_a { 100, 100 };
+            shadowcasting.compute(map, a, 100, from_a);
+            for (int j = 0; j < 50; ++j) {
+                auto b = cells[rng.gen_int(0, static_cast<int>(cells.size()))];
+                BitGrid from_b { 100, 100 };
+                shadowcasting.compute(map, b, 100, from_b);
+                asymmetric += from_a.test(b.x, b.y) != from_b.test(a.x, a.y);
+            }
+        }
+        CHECK(asymmetric == 0);
+    }
+
+    return test::result("fov");
+}
@@ -0,0 +1,61 @@
+// Level spawns: the player and every enemy get distinct empty cells of the
+// first window, which is cut from the world around the start's chunk
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "map/level.hpp"
+#include "test.hpp"
+
+int main() {
+    logger::init("tests.log");
+    ShadowcastingFov fov;
+    DrunkardGenerator drunkard;
+    CaveGenerator cave;
+
+    int overlaps = 0;
+    int misplaced = 0;
+    int outside = 0;
+    for (std::uint64_t seed = 1; seed <= 200; ++seed) {
+        // A single chunk window makes collisions likely if start and enemies
+        // were drawn independently
+        int size = seed % 2 == 0 ? Chunk::size : window_size(20);
+        const Generator *generator = seed % 3 == 0 ? static_cast<const Generator*>(&cave) : &drunkard;
+        LevelSpec spec { size, size, 30, 5, 3, LightColor { 60, 110, 255 }, generator };
+        auto level = generate_level(spec, seed, fov);
+        auto &map = *level.map;
+        auto start = ChunkedMap::hub(ChunkCoord { 0, 0 });
+        outside += level.origin + level.start != start
+            || level.start.x < 0 || level.start.y < 0 || level.start.x >= map.get_w() || level.start.y >= map.get_h();
+
+        std::vector<Vector2D> taken { level.start };
+        for (auto &enemy : level.enemies) {
+            taken.push_back(enemy.pos);
+        }
+        for (std::size_t i = 0; i < taken.size(); ++i) {
+            misplaced += map.at(taken[i].x, taken[i].y) != TileType::Empty;
+            for (std::size_t j = i + 1; j < taken.size(); ++j) {
+                overlaps += taken[i] == taken[j];
+            }
+        }
+        CHECK(level.enemies.size() == std::min<std::size_t>(30, map.empty_count() - 1));
+
+        // The window is a copy of the world
+        int differ = 0;
+        for (int y = 0; y < map.get_h(); ++y) {
+            for (int x = 0; x < map.get_w(); ++x) {
+                differ += map.at(x, y) != level.world->at(level.origin.x + x, level.origin.y + y);
+            }
+        }
+        CHECK(differ == 0);
+
+        std::string pages = level.world->page_dir();
+        level.world.reset();
+        std::filesystem::remove_all(pages);
+    }
+    CHECK(outside == 0);
+    CHECK(overlaps == 0);
+    CHECK(misplaced == 0);
+
+    return test::result("level");
+}
@@ -0,0 +1,101 @@
+// Lighting has to stay exact under heavy overlap: adding and removing lights
+// in any order must bring every cell back to what it was
+#include <vector>
+
+#include "map/lighting.hpp"
+#include "random.hpp"
+#include "test.hpp"
+
+int main() {
+    ShadowcastingFov fov;
+    Grid<TileType> map { 32, 32, TileType::Empty };
+    LightColor ambient { 10, 20, 30 };
+    Lighting lighting { 32, 32, ambient };
+
+    // 512 * 128 is exactly where 16 bit sums wrap to 0
+    std::vector<LightId> stacked;
+    for (int i = 0; i < 512; ++i) {
+        stacked.push_back(lighting.add(Vector2D { 16, 16 }, 6, LightColor { 128, 128, 128 }));
+    }
+    CHECK(lighting.update(fov, map));
+    CHECK(lighting.intensity(16, 16) == 255);
+    CHECK(lighting.intensity(22, 16) > ambient.b);
+    // Nothing moved, nothing to resolve: the darkness overlay relies on it
+    CHECK(!lighting.update(fov, map));
+
+    // Removing all but one leaves exactly that one
+    Lighting single { 32, 32, ambient };
+    single.add(Vector2D { 16, 16 }, 6, LightColor { 128, 128, 128 });
+    single.update(fov, map);
+    for (std::size_t i = 1; i < stacked.size(); ++i) {
+        lighting.remove(stacked[i]);
+    }
+    lighting.update(fov, map);
+    int differ = 0;
+    for (int y = 0; y < 32; ++y) {
+        for (int x = 0; x < 32; ++x) {
+            auto a = lighting.color(x, y);
+            auto b = single.color(x, y);
+            differ += a.r != b.r || a.g != b.g || a.b != b.b;
+        }
+    }
+    CHECK(differ == 0);
+
+    // Random moves and removals end at ambient light everywhere
+    rng::Rng rng { 11 };
+    std::vector<LightId> lights { stacked[0] };
+    for (int i = 0; i < 500; ++i) {
+        lights.push_back(lighting.add(Vector2D { rng.gen_int(0, 32), rng.gen_int(0, 32) }, rng.gen_int(1, 9),
+                    LightColor { 255, static_cast<std::uint8_t>(rng.gen_int(0, 256)), 40 }));
+    }
+    for (int step = 0; step < 5; ++step) {
+        for (auto id : lights) {
+            lighting.move(id, Vector2D { rng.gen_int(0, 32), rng.gen_int(0, 32) });
+        }
+        lighting.update(fov, map);
+    }
+    for (auto id : lights) {
+        lighting.remove(id);
+    }
+    lighting.update(fov, map);
+    int lit = 0;
+    for (int y = 0; y < 32; ++y) {
+        for (int x = 0; x < 32; ++x) {
+            auto c = lighting.color(x, y);
+            lit += c.r != ambient.r || c.g != ambient.g || c.b != ambient.b;
+        }
+    }
+    CHECK(lit == 0);
+
+    // Among walls and against the edges, each light's box sized visibility
+    // lights exactly the cells a full map FOV sees within its disc
+    Grid<TileType> walls { 64, 48, TileType::Empty };
+    for (int y = 0; y < walls.get_h(); ++y) {
+        for (int x = 0; x < walls.get_w(); ++x) {
+            if (rng.gen_int(0, 100) < 25) {
+                walls.set(x, y, TileType::Wall);
+            }
+        }
+    }
+    int wrong = 0;
+    for (int i = 0; i < 60; ++i) {
+        Lighting one { 64, 48 };
+        Vector2D pos { rng.gen_int(-2, 66), rng.gen_int(-2, 50) };
+        int radius = rng.gen_int(1, 12);
+        one.add(pos, radius, LightColor { 255, 255, 255 });
+        one.update(fov, walls);
+
+        BitGrid seen { 64, 48 };
+        fov.compute(walls, pos, radius, seen);
+        for (int y = 0; y < 48; ++y) {
+            for (int x = 0; x < 64; ++x) {
+                auto d = Vector2D { x, y } - pos;
+                bool expected = seen.test(x, y) && d.x * d.x + d.y * d.y <= radius * radius;
+                wrong += (one.intensity(x, y) > 0) != expected;
+            }
+        }
+    }
+    CHECK(wrong == 0);
+
+    return test::result("lighting");
+}
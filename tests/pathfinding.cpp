@@ -0,0 +1,109 @@
+// Jump Point Search against plain BFS: same reachability, equally short
+// and valid paths, and no allocations once the buffers are warm
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "map/pathfinding.hpp"
+#include "random.hpp"
+#include "test.hpp"
+
+namespace {
+    std::size_t allocations = 0;
+};
+
+void* operator new(std::size_t size) {
+    ++allocations;
+    if (auto p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc {};
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+bool walkable(const Grid<TileType> &map, Vector2D p) {
+    return map.in_bounds(p.x, p.y) && map.get(p.x, p.y) != TileType::Wall;
+}
+
+int main() {
+    rng::Rng rng { 20 };
+
+    int unreachable_mismatch = 0;
+    int longer = 0;
+    int broken = 0;
+    int paths = 0;
+
+    Pathfinder pathfinder;
+    DijkstraMap bfs;
+    std::vector<Vector2D> path;
+
+    // Open fields to mazes, plus a size change in between
+    for (int density : { 0, 10, 25, 35, 45 }) {
+        for (int size : { 17, 48 }) {
+            Grid<TileType> map { size, size + 3, TileType::Empty };
+            for (int y = 0; y < map.get_h(); ++y) {
+                for (int x = 0; x < map.get_w(); ++x) {
+                    if (rng.gen_int(0, 100) < density) {
+                        map.set(x, y, TileType::Wall);
+                    }
+                }
+            }
+            pathfinder.resize(map.get_w(), map.get_h());
+            bfs.resize(map.get_w(), map.get_h());
+
+            for (int i = 0; i < 150; ++i) {
+                Vector2D from { rng.gen_int(0, map.get_w()), rng.gen_int(0, map.get_h()) };
+                Vector2D to { rng.gen_int(0, map.get_w()), rng.gen_int(0, map.get_h()) };
+                bfs.compute(map, to);
+                int distance = walkable(map, from) ? bfs.distance(from.x, from.y) : DijkstraMap::unreachable;
+
+                bool found = pathfinder.find_path(map, from, to, path);
+                if (found != (distance != DijkstraMap::unreachable)) {
+                    ++unreachable_mismatch;
+                    continue;
+                }
+                if (!found) {
+                    broken += !path.empty();
+                    continue;
+                }
+
+                ++paths;
+                longer += static_cast<int>(path.size()) != distance;
+                // Unit steps over open cells, ending on the goal
+                auto at = from;
+                for (auto step : path) {
+                    auto d = step - at;
+                    broken += std::abs(d.x) + std::abs(d.y) != 1 || !walkable(map, step);
+                    at = step;
+                }
+                broken += !(at == to);
+            }
+        }
+    }
+    CHECK(unreachable_mismatch == 0);
+    CHECK(longer == 0);
+    CHECK(broken == 0);
+    CHECK(paths > 500);
+
+    // Same map size again: the warm buffers serve every query
+    Grid<TileType> cave { 48, 51, TileType::Empty };
+    for (int y = 0; y < cave.get_h(); ++y) {
+        for (int x = 0; x < cave.get_w(); ++x) {
+            if (rng.gen_int(0, 100) < 30) {
+                cave.set(x, y, TileType::Wall);
+            }
+        }
+    }
+    path.reserve(static_cast<std::size_t>(cave.get_w()) * cave.get_h());
+    auto before = allocations;
+    for (int i = 0; i < 2000; ++i) {
+        pathfinder.find_path(cave, Vector2D { rng.gen_int(0, 48), rng.gen_int(0, 51) },
+                Vector2D { rng.gen_int(0, 48), rng.gen_int(0, 51) }, path);
+        bfs.compute(cave, Vector2D { rng.gen_int(0, 48), rng.gen_int(0, 51) });
+    }
+    CHECK(allocations == before);
+
+    return test::result("pathfinding");
+}
@@ -0,0 +1,71 @@
+// Named streams: the init() thread replays its seed, every other thread
+// draws from its own streams, distinct from the rest and reseeded by init()
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "random.hpp"
+#include "test.hpp"
+
+std::vector<std::uint64_t> draw(rng::Stream s, int n) {
+    std::vector<std::uint64_t> out;
+    for (int i = 0; i < n; ++i) {
+        out.push_back(rng::stream(s).next());
+    }
+    return out;
+}
+
+int main() {
+    rng::init(17);
+    auto replay = draw(rng::Stream::Map, 64);
+    CHECK(draw(rng::Stream::Map, 0).empty());
+
+    // Same as a generator jumped to the stream's index
+    rng::Rng expected { 17, static_cast<std::uint64_t>(rng::Stream::Map) };
+    bool same = true;
+    for (auto v : replay) {
+        same &= v == expected.next();
+    }
+    CHECK(same);
+
+    rng::init(17);
+    CHECK(draw(rng::Stream::Map, 64) == replay);
+    CHECK(draw(rng::Stream::Spawn, 64) != replay);
+
+    // Workers draw concurrently, none sees the main thread's or another's values
+    constexpr int workers = 4;
+    std::vector<std::vector<std::uint64_t>> drawn(workers);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < workers; ++i) {
+        threads.emplace_back([&drawn, i] { drawn[i] = draw(rng::Stream::Map, 64); });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    for (int i = 0; i < workers; ++i) {
+        CHECK(drawn[i] != replay);
+        for (int j = i + 1; j < workers; ++j) {
+            CHECK(drawn[i] != drawn[j]);
+        }
+    }
+
+    // A thread that drew before init() gets fresh streams from the new seed
+    std::vector<std::uint64_t> before;
+    std::vector<std::uint64_t> after;
+    std::atomic<int> step { 0 };
+    std::thread worker([&] {
+        before = draw(rng::Stream::Main, 8);
+        step = 1;
+        while (step != 2) std::this_thread::yield();
+        after = draw(rng::Stream::Main, 8);
+    });
+    while (step != 1) std::this_thread::yield();
+    rng::init(99);
+    step = 2;
+    worker.join();
+    CHECK(before != after);
+    CHECK(rng::seed() == 99);
+
+    return test::result("random");
+}
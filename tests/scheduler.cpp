@@ -0,0 +1,163 @@
+// The parallel scheduler has to leave the world exactly as running the same
+// systems one by one does: many systems with overlapping read/write sets,
+// chunked par_each iteration and structural changes through commands
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "ecs/ecs.hpp"
+#include "random.hpp"
+#include "test.hpp"
+
+template <int N>
+struct C { std::uint32_t v; };
+
+template <typename T>
+struct ecs::ComponentId : ecs::type_index<T, ecs::TypeList<C<0>, C<1>, C<2>, C<3>, C<4>, C<5>, C<6>, C<7>>> { };
+
+// Writes C<W> from the C<Rs> of the same entity, in chunks of 64 rows
+template <int W, int... Rs>
+void add_mixer(ecs::Scheduler &scheduler, std::uint32_t salt) {
+    scheduler.add_system<ecs::Reads<C<Rs>...>, ecs::Writes<C<W>>>("mix" + std::to_string(salt), [salt](ecs::SystemContext &ctx) {
+        ctx.world.view<C<W>, C<Rs>...>().par_each(ctx.pool, [salt](C<W> &w, C<Rs>&... rs) {
+            w.v = w.v * 2654435761u + (salt + ... + rs.v);
+        }, 64);
+    });
+}
+
+void add_systems(ecs::Scheduler &scheduler) {
+    add_mixer<0, 1, 2>(scheduler, 1);
+    add_mixer<3, 4>(scheduler, 2);
+    add_mixer<5>(scheduler, 3);
+    add_mixer<6, 7>(scheduler, 4);
+    add_mixer<1, 0>(scheduler, 5);
+    add_mixer<2, 3, 4>(scheduler, 6);
+    add_mixer<4, 5, 6>(scheduler, 7);
+    add_mixer<7, 1>(scheduler, 8);
+    add_mixer<0, 7>(scheduler, 9);
+    add_mixer<5, 2>(scheduler, 10);
+
+    // Spawns and destroys through commands, driven by what the mixers left
+    scheduler.add_system<ecs::Reads<C<0>, C<1>>>("churn", [](ecs::SystemContext &ctx) {
+        std::uint32_t spawned = 0;
+        ctx.world.view<C<0>, C<1>>().each([&](ecs::EntityId e, C<0> &a, C<1> &b) {
+            if ((a.v ^ b.v) % 61 == 0) {
+                ctx.commands.destroy(e);
+            } else if (a.v % 97 == 0 && spawned < 50) {
+                auto child = ctx.commands.create();
+                ctx.commands.add_component<C<0>>(child, C<0> { b.v });
+                ctx.commands.add_component<C<1>>(child, C<1> { a.v });
+                ctx.commands.add_component<C<3>>(child, C<3> { spawned++ });
+            }
+        });
+    });
+
+    add_mixer<3, 0, 1, 2>(scheduler, 11);
+    add_mixer<6>(scheduler, 12);
+    add_mixer<1, 5, 6, 7>(scheduler, 13);
+    add_mixer<4, 3>(scheduler, 14);
+    add_mixer<2, 6>(scheduler, 15);
+
+    // Touches the world directly, runs alone
+    scheduler.add_exclusive_system("tag", [](ecs::SystemContext &ctx) {
+        std::vector<ecs::EntityId> tagged;
+        ctx.world.view<C<4>>().each([&](ecs::EntityId e, C<4> &c) {
+            if (c.v % 13 == 0 && !ctx.world.has_component<C<7>>(e)) {
+                tagged.push_back(e);
+            }
+        });
+        for (auto e : tagged) {
+            ctx.world.add_component<C<7>>(e, C<7> { e.value() });
+        }
+    });
+
+    add_mixer<7, 4>(scheduler, 16);
+    add_mixer<0, 3, 5>(scheduler, 17);
+    add_mixer<5, 7>(scheduler, 18);
+    add_mixer<1, 2>(scheduler, 19);
+    add_mixer<6, 0, 4>(scheduler, 20);
+}
+
+void populate(ecs::World &world) {
+    rng::Rng rng { 1234 };
+    for (int i = 0; i < 20000; ++i) {
+        auto e = world.create();
+        for (int k = 0; k < 8; ++k) {
+            if (rng.gen_int(0, 3) == 0) {
+                continue;
+            }
+            auto v = static_cast<std::uint32_t>(rng.gen_int(0, 1 << 30));
+            switch (k) {
+                case 0: world.add_component<C<0>>(e, C<0> { v }); break;
+                case 1: world.add_component<C<1>>(e, C<1> { v }); break;
+                case 2: world.add_component<C<2>>(e, C<2> { v }); break;
+                case 3: world.add_component<C<3>>(e, C<3> { v }); break;
+                case 4: world.add_component<C<4>>(e, C<4> { v }); break;
+                case 5: world.add_component<C<5>>(e, C<5> { v }); break;
+                case 6: world.add_component<C<6>>(e, C<6> { v }); break;
+                case 7: world.add_component<C<7>>(e, C<7> { v }); break;
+            }
+        }
+    }
+}
+
+using State = std::vector<std::tuple<std::uint64_t, int, std::uint32_t>>;
+
+template <int K>
+void collect(ecs::World &world, State &state) {
+    world.view<C<K>>().each([&](ecs::EntityId e, C<K> &c) { state.emplace_back(e.value(), K, c.v); });
+}
+
+// Every component of every entity, in a layout independent order
+State snapshot(ecs::World &world) {
+    State state;
+    collect<0>(world, state);
+    collect<1>(world, state);
+    collect<2>(world, state);
+    collect<3>(world, state);
+    collect<4>(world, state);
+    collect<5>(world, state);
+    collect<6>(world, state);
+    collect<7>(world, state);
+    std::sort(state.begin(), state.end());
+    return state;
+}
+
+State run(ecs::ThreadPool *pool, std::size_t &stages) {
+    ecs::World world;
+    populate(world);
+
+    ecs::Scheduler scheduler;
+    add_systems(scheduler);
+    scheduler.set_pool(pool);
+    stages = scheduler.stages();
+
+    for (int frame = 0; frame < 40; ++frame) {
+        scheduler.run(world);
+    }
+    return snapshot(world);
+}
+
+int main() {
+    logger::init("tests.log");
+
+    std::size_t stages = 0;
+    auto serial = run(nullptr, stages);
+    // Some stages must hold several systems for this to test anything
+    CHECK(stages < 22);
+    CHECK(serial.size() > 10000);
+
+    for (std::size_t workers : { 1, 2, 4, 8 }) {
+        ecs::ThreadPool pool { workers };
+        for (int repeat = 0; repeat < 3; ++repeat) {
+            std::size_t parallel_stages = 0;
+            auto parallel = run(&pool, parallel_stages);
+            CHECK(parallel_stages == stages);
+            CHECK(parallel == serial);
+        }
+    }
+
+    return test::result("scheduler");
+}
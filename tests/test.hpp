@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdio>
+
+namespace test {
+    inline int& failures() {
+        static int count = 0;
+        return count;
+    }
+
+    // Reports the result of one check, failed ones are counted
+    inline bool check(bool ok, const char* what, const char* file, int line) {
+        if (!ok) {
+            std::printf("%s:%d: FAILED %s\n", file, line, what);
+            ++failures();
+        }
+        return ok;
+    }
+
+    // Exit status of a test program
+    inline int result(const char* name) {
+        std::printf("%s: %s\n", name, failures() == 0 ? "ok" : "FAILED");
+        return failures() == 0 ? 0 : 1;
+    }
+};
+
+#define CHECK(cond) test::check((cond), #cond, __FILE__, __LINE__)